@@ -15,8 +15,10 @@
 
 // Solution of Langford pair problem using DLX
 //////////////////////////////////////////////
+#include <algorithm>  // min
 #include <cassert>
 #include <chrono>
+#include <cstdio>  // rename, remove
 #include <cstring>
 #include <ctime>  // time
 #include <fstream>
@@ -27,13 +29,16 @@
 #include <unordered_map>
 #include <vector>
 
+#include "dlx_bitset_matrix.hpp"
 #include "dlx_matrix.hpp"
+#include "dlx_parallel.hpp"
 
 namespace cron = std::chrono;
 
 char hex(size_t l) { return l < 10 ? '0' + l : 'a' + l - 10; }
 
-std::string sol_to_string(size_t N, DLX_backtrack::DLXMatrix &M,
+template <typename Matrix>
+std::string sol_to_string(size_t N, const Matrix &M,
                           DLX_backtrack::DLXMatrix::Vect1D sol) {
   std::string res(2 * N, '_');
   for (size_t irow : sol) {
@@ -48,7 +53,40 @@ std::string sol_to_string(size_t N, DLX_backtrack::DLXMatrix &M,
 
 int main(int argc, char *argv[]) {
   size_t N = 4;
+  bool bitset = false;  // use the bitset engine
+  bool symmetry = false;  // only explore one of a solution and its reversal
+  size_t nb_threads = 0;  // 0 : sequential search
+  std::string checkpoint;  // checkpoint file of the count
+  unsigned long interval = 0;  // number of choices between checkpoints
   auto tstart = cron::high_resolution_clock::now();
+  if (argc > 1 && std::strcmp(argv[1], "-b") == 0) {
+    bitset = true;
+    argc--;
+    argv++;
+  } else if (argc > 1 && std::strcmp(argv[1], "-s") == 0) {
+    symmetry = true;
+    argc--;
+    argv++;
+  } else if (argc > 2 && std::strcmp(argv[1], "-j") == 0) {
+    char *check;
+    nb_threads = strtol(argv[2], &check, 10);
+    if (*check != '\0' || nb_threads == 0) {
+      std::cerr << "bad number of threads: " << argv[2] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    argc -= 2;
+    argv += 2;
+  } else if (argc > 3 && std::strcmp(argv[1], "-c") == 0) {
+    checkpoint = argv[2];
+    char *check;
+    interval = strtoul(argv[3], &check, 10);
+    if (*check != '\0' || interval == 0) {
+      std::cerr << "bad checkpoint interval: " << argv[3] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    argc -= 3;
+    argv += 3;
+  }
   if (argc == 2) {
     char *check;
     N = strtol(argv[1], &check, 10);
@@ -79,21 +117,94 @@ int main(int argc, char *argv[]) {
   // std::cout << M << std::endl;
 
   auto tcompute = std::chrono::high_resolution_clock::now();
-  std::vector<size_t> soldance;
-  if (!M.search_iter(soldance)) {
-    std::cout << "No solution found !" << std::endl;
-    exit(EXIT_FAILURE);
+  DLX_backtrack::DLXMatrix::count_t nsol = 0;
+  unsigned long nb_choices, nb_dances;
+  auto solve = [&](auto &&S) {
+    std::vector<size_t> soldance;
+    if (!S.search_iter(soldance)) {
+      std::cout << "No solution found !" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << sol_to_string(N, S, soldance) << std::endl;
+    // search for other solutions
+    nsol = 1;
+    while (S.search_iter()) nsol++;
+    nb_choices = S.nb_choices;
+    nb_dances = S.nb_dances;
+  };
+  if (bitset) {
+    solve(DLX_backtrack::DLXBitsetMatrix(M));
+  } else {
+    std::vector<size_t> soldance;
+    if (!DLX_backtrack::DLXMatrix(M).search_iter(soldance)) {
+      std::cout << "No solution found !" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    std::cout << sol_to_string(N, M, soldance) << std::endl;
+  }
+  if (nb_threads > 0) {
+    DLX_backtrack::ParallelOptions opts;
+    opts.nb_threads = nb_threads;
+    opts.count_only = true;
+    auto res = DLX_backtrack::search_parallel(M, opts);
+    nsol = res.nb_solutions;
+    nb_choices = res.nb_choices;
+    nb_dances = res.nb_dances;
+  } else if (symmetry) {
+    // Reversing the positions maps the solutions onto the solutions
+    std::vector<size_t> reversal(3 * N);
+    for (size_t i = 0; i < N; i++) reversal[i] = i;
+    for (size_t p = 0; p < 2 * N; p++) reversal[N + p] = 3 * N - 1 - p;
+    M.add_symmetry(reversal);
+    nsol = M.count_solutions_sym();
+    nb_choices = M.nb_choices;
+    nb_dances = M.nb_dances;
+  } else if (!checkpoint.empty()) {
+    // Resume from the checkpoint if any, and save the position of the
+    // search every interval choices.
+    std::ifstream in(checkpoint);
+    if (in) {
+      std::string count;
+      M.load_checkpoint(in);
+      in >> count;
+      nsol = DLX_backtrack::count_from_string(count);
+      std::cout << "# Resumed from " << checkpoint << std::endl;
+    }
+    DLX_backtrack::SearchStatus st;
+    unsigned long next = M.nb_choices + interval;
+    while ((st = M.search_step(next - std::min(next, M.nb_choices))) !=
+           DLX_backtrack::SearchStatus::finished) {
+      if (st == DLX_backtrack::SearchStatus::solution) {
+        nsol++;
+        continue;
+      }
+      next = M.nb_choices + interval;
+      std::string tmp = checkpoint + ".tmp";
+      std::ofstream out(tmp);
+      M.save_checkpoint(out);
+      out << DLX_backtrack::count_to_string(nsol) << std::endl;
+      out.close();
+      if (!out || std::rename(tmp.c_str(), checkpoint.c_str()) != 0) {
+        std::cerr << "cannot write checkpoint " << checkpoint << std::endl;
+        exit(EXIT_FAILURE);
+      }
+    }
+    std::remove(checkpoint.c_str());
+    nb_choices = M.nb_choices;
+    nb_dances = M.nb_dances;
+  } else if (!bitset) {
+    M.set_kernel_threshold(DLX_backtrack::DLXMatrix::max_kernel_cols);
+    nsol = M.count_solutions();
+    nb_choices = M.nb_choices;
+    nb_dances = M.nb_dances;
   }
-  std::cout << sol_to_string(N, M, soldance) << std::endl;
-  // search for other solutions
-  size_t nsol = 1;
-  while (M.search_iter()) nsol++;
   auto endcompute = cron::high_resolution_clock::now();
 
-  std::cout << "Number of solutions: " << nsol << std::endl;
+  std::cout << "Number of solutions: " << DLX_backtrack::count_to_string(nsol)
+            << std::endl;
   auto endprint = cron::high_resolution_clock::now();
-  std::cout << "# Number of choices: " << M.nb_choices
-            << ", Number of dances: " << M.nb_dances << "\n";
+  std::cout << "# Number of choices: " << nb_choices
+            << ", Number of dances: " << nb_dances << "\n";
   std::cout << std::fixed << std::setprecision(0) << "# Timings: parse = "
             << cron::duration<float, std::micro>(tencode - tstart).count()
             << "μs, encode = "
@@ -0,0 +1,87 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Column choice: scanning the active columns vs the bucket queue
+//
+// Langford problems are narrow (3N columns); the tilings of a long strip by
+// dominoes and L-trominoes have thousands of columns of which only a few
+// are constrained at each step.
+//////////////////////////////////////////////////////////////////////////////
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "dlx_examples.hpp"
+#include "dlx_matrix.hpp"
+
+namespace cron = std::chrono;
+using namespace DLX_backtrack;
+
+using ind_t = DLXMatrix::ind_t;
+
+// Tilings of a 3 x len strip; the cell (r, c) is the column 3 * c + r
+DLXMatrix Strip(ind_t len) {
+  DLXMatrix M(3 * len);
+  auto cell = [](ind_t r, ind_t c) { return 3 * c + r; };
+  for (ind_t c = 0; c < len; c++) {
+    for (ind_t r = 0; r < 3; r++) {
+      if (r + 1 < 3) M.add_row({cell(r, c), cell(r + 1, c)});
+      if (c + 1 < len) M.add_row({cell(r, c), cell(r, c + 1)});
+    }
+    if (c + 1 < len) {
+      for (ind_t r = 0; r + 1 < 3; r++) {
+        M.add_row({cell(r, c), cell(r + 1, c), cell(r, c + 1)});
+        M.add_row({cell(r, c), cell(r + 1, c), cell(r + 1, c + 1)});
+        M.add_row({cell(r, c), cell(r, c + 1), cell(r + 1, c + 1)});
+        M.add_row({cell(r + 1, c), cell(r, c + 1), cell(r + 1, c + 1)});
+      }
+    }
+  }
+  return M;
+}
+
+void bench(const std::string &name, const DLXMatrix &M0,
+           DLXMatrix::count_t max_sol) {
+  for (bool buckets : {false, true}) {
+    DLXMatrix M(M0);
+    M.set_bucket_queue(buckets);
+    auto tstart = cron::high_resolution_clock::now();
+    DLXMatrix::count_t nb = M.count_up_to(max_sol);
+    auto tfin = cron::high_resolution_clock::now();
+    std::cout << std::setw(16) << name << std::setw(8) << M.nb_cols()
+              << std::setw(9) << (buckets ? "buckets" : "scan")
+              << std::setw(10) << count_to_string(nb) << std::setw(12)
+              << M.nb_choices << std::fixed << std::setprecision(3)
+              << std::setw(10)
+              << cron::duration<double>(tfin - tstart).count() << "s"
+              << std::endl;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  bool quick = argc > 1 && std::strcmp(argv[1], "-q") == 0;
+  std::cout << std::setw(16) << "instance" << std::setw(8) << "cols"
+            << std::setw(9) << "choice" << std::setw(10) << "sols"
+            << std::setw(12) << "choices" << std::setw(11) << "time"
+            << std::endl;
+  ind_t N = quick ? 8 : 11;
+  bench("Langford " + std::to_string(N), Langford_matrix(N), -1);
+  for (ind_t len : {100, 1000, 5000}) {
+    if (quick) len /= 10;
+    bench("Strip " + std::to_string(len), Strip(len), quick ? 1000 : 100000);
+  }
+}
@@ -0,0 +1,503 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Benchmark of the search on a fixed corpus
+//
+//   bench_corpus [-q] [-k <threshold>] [-c <baseline>] [<prefix>...]
+//
+// runs the instances whose name starts with one of the prefixes (all by
+// default, a smaller corpus with -q), each in its own process so that the
+// peak memory is its own. The results are written as tab separated values,
+// one line per instance, the lines starting with # being comments. The
+// searches shorter than 0.1s are repeated and their time is the mean one.
+// With -k, each search is timed again with the bitset kernel below the given
+// number of columns, its speedup being larger than 1 if the kernel is
+// faster. With -c, the time of each instance is compared with the one of a
+// previous output, the speedup being larger than 1 if the search is now
+// faster.
+//////////////////////////////////////////////////////////////////////////////
+#include <sys/resource.h>  // getrusage
+#include <sys/wait.h>      // waitpid
+#include <unistd.h>        // fork
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dlx_examples.hpp"
+#include "dlx_matrix.hpp"
+
+namespace cron = std::chrono;
+using namespace DLX_backtrack;
+
+using ind_t = DLXMatrix::ind_t;
+using Vect1D = DLXMatrix::Vect1D;
+
+/////////////////////////
+// Sudokus of size n = b * b with the standard blocks. The items are the
+// cells, then the digits in the rows, the columns and the blocks; the hints
+// are chosen.
+DLXMatrix Sudoku(ind_t b, const std::vector<ind_t> &grid) {
+  const ind_t n = b * b, n2 = n * n;
+  DLXMatrixBuilder builder(4 * n2);
+  builder.reserve(n * n2, 4 * n * n2);
+  for (ind_t r = 0; r < n; r++)
+    for (ind_t c = 0; c < n; c++)
+      for (ind_t d = 0; d < n; d++)
+        builder.add_row({r * n + c, n2 + r * n + d, 2 * n2 + c * n + d,
+                         3 * n2 + (r / b * b + c / b) * n + d});
+  DLXMatrix M = builder.finalize();
+  for (ind_t cell = 0; cell < n2; cell++)
+    if (grid[cell] != 0) M.choose(cell * n + grid[cell] - 1);
+  return M;
+}
+
+DLXMatrix Sudoku9(const std::string &puzzle) {
+  std::vector<ind_t> grid;
+  for (char ch : puzzle) grid.push_back(ch == '.' ? 0 : ch - '0');
+  return Sudoku(3, grid);
+}
+
+// A random grid of size b * b keeping the given ratio of hints. The
+// shuffles depend on the standard library, so that a baseline is only
+// comparable with the same compiler.
+DLXMatrix RandomSudoku(ind_t b, double ratio, unsigned seed) {
+  const ind_t n = b * b;
+  std::mt19937 rng(seed);
+  Vect1D digits(n), rows(n), cols(n);
+  std::iota(digits.begin(), digits.end(), 1);
+  std::shuffle(digits.begin(), digits.end(), rng);
+  // Permuting the rows of each band and the bands keeps a valid grid
+  for (Vect1D *perm : {&rows, &cols}) {
+    Vect1D bands(b);
+    std::iota(bands.begin(), bands.end(), 0);
+    std::shuffle(bands.begin(), bands.end(), rng);
+    for (ind_t i = 0; i < b; i++) {
+      Vect1D inner(b);
+      std::iota(inner.begin(), inner.end(), 0);
+      std::shuffle(inner.begin(), inner.end(), rng);
+      for (ind_t j = 0; j < b; j++)
+        (*perm)[i * b + j] = bands[i] * b + inner[j];
+    }
+  }
+  std::bernoulli_distribution keep(ratio);
+  std::vector<ind_t> grid(n * n);
+  for (ind_t r = 0; r < n; r++) {
+    for (ind_t c = 0; c < n; c++) {
+      ind_t pr = rows[r], pc = cols[c];
+      ind_t d = digits[(pr % b * b + pr / b + pc) % n];
+      if (keep(rng)) grid[r * n + c] = d;
+    }
+  }
+  return Sudoku(b, grid);
+}
+
+/////////////////////////
+// The rows and columns are primary, the diagonals are secondary
+DLXMatrix Queens(ind_t N) {
+  DLXMatrixBuilder builder(6 * N - 2, 2 * N);
+  for (ind_t r = 0; r < N; r++)
+    for (ind_t c = 0; c < N; c++)
+      builder.add_row({r, N + c, 2 * N + r + c, 5 * N - 2 + r - c});
+  return builder.finalize();
+}
+
+/////////////////////////
+// Tilings of a rectangle by the twelve pentominoes. The items are the
+// pieces, then the cells.
+DLXMatrix Pentominoes(ind_t height, ind_t width) {
+  using Shape = std::vector<std::pair<int, int>>;
+  static const std::array<Shape, 12> pieces = {{
+      {{0, 1}, {0, 2}, {1, 0}, {1, 1}, {2, 1}},  // F
+      {{0, 0}, {0, 1}, {0, 2}, {0, 3}, {0, 4}},  // I
+      {{0, 0}, {1, 0}, {2, 0}, {3, 0}, {3, 1}},  // L
+      {{0, 1}, {1, 1}, {2, 0}, {2, 1}, {3, 0}},  // N
+      {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {2, 0}},  // P
+      {{0, 0}, {0, 1}, {0, 2}, {1, 1}, {2, 1}},  // T
+      {{0, 0}, {0, 2}, {1, 0}, {1, 1}, {1, 2}},  // U
+      {{0, 0}, {1, 0}, {2, 0}, {2, 1}, {2, 2}},  // V
+      {{0, 0}, {1, 0}, {1, 1}, {2, 1}, {2, 2}},  // W
+      {{0, 1}, {1, 0}, {1, 1}, {1, 2}, {2, 1}},  // X
+      {{0, 1}, {1, 0}, {1, 1}, {2, 1}, {3, 1}},  // Y
+      {{0, 0}, {0, 1}, {1, 1}, {2, 1}, {2, 2}},  // Z
+  }};
+  DLXMatrixBuilder builder(12 + height * width);
+  for (ind_t p = 0; p < 12; p++) {
+    // The distinct orientations, moved to the upper left corner
+    std::set<Shape> shapes;
+    Shape shape = pieces[p];
+    for (int flip = 0; flip < 2; flip++) {
+      for (int rot = 0; rot < 4; rot++) {
+        for (auto &[r, c] : shape) std::tie(r, c) = std::make_pair(c, -r);
+        int rmin = 99, cmin = 99;
+        for (auto [r, c] : shape) {
+          rmin = std::min(rmin, r);
+          cmin = std::min(cmin, c);
+        }
+        Shape normal;
+        for (auto [r, c] : shape) normal.emplace_back(r - rmin, c - cmin);
+        std::sort(normal.begin(), normal.end());
+        shapes.insert(normal);
+      }
+      for (auto &rc : shape) rc.second = -rc.second;
+    }
+    for (const Shape &sh : shapes) {
+      for (int r0 = 0; r0 < int(height); r0++) {
+        for (int c0 = 0; c0 < int(width); c0++) {
+          Vect1D row{p};
+          for (auto [r, c] : sh)
+            if (r0 + r < int(height) && c0 + c < int(width))
+              row.push_back(12 + (r0 + r) * width + c0 + c);
+          if (row.size() == 6) builder.add_row(row);
+        }
+      }
+    }
+  }
+  return builder.finalize();
+}
+
+/////////////////////////
+// Tectonic puzzles: each block of size s holds the numbers 1 ... s, and
+// neighbor cells, diagonally included, hold different numbers. The items
+// are the cells and the pairs (block, number), then the secondary pairs
+// (neighbor cells in different blocks, number). The hints are given as
+// (row, column, number).
+DLXMatrix Tectonic(const std::vector<std::string> &blocks,
+                   const std::vector<std::array<ind_t, 3>> &hints) {
+  const int nrows = blocks.size(), ncols = blocks[0].size();
+  std::map<char, ind_t> size, first_item;
+  for (const std::string &line : blocks)
+    for (char bl : line) size[bl]++;
+  ind_t nb_items = nrows * ncols;
+  for (auto [bl, sz] : size) {
+    first_item[bl] = nb_items;
+    nb_items += sz;
+  }
+  const ind_t nb_primary = nb_items;
+  // The neighbors in another block, and their number in the secondary items
+  std::map<std::pair<int, int>, ind_t> pairs;
+  auto cell = [ncols](int r, int c) { return r * ncols + c; };
+  for (int r = 0; r < nrows; r++) {
+    for (int c = 0; c < ncols; c++) {
+      for (auto [rd, cd] : {std::make_pair(1, 0), {-1, 1}, {0, 1}, {1, 1}}) {
+        int rn = r + rd, cn = c + cd;
+        if (0 <= rn && rn < nrows && 0 <= cn && cn < ncols &&
+            blocks[r][c] != blocks[rn][cn]) {
+          pairs[{cell(r, c), cell(rn, cn)}] = nb_items;
+          nb_items += std::min(size[blocks[r][c]], size[blocks[rn][cn]]);
+        }
+      }
+    }
+  }
+  std::map<ind_t, ind_t> hint;
+  for (auto [r, c, l] : hints) hint[cell(r, c)] = l;
+  DLXMatrixBuilder builder(nb_items, nb_primary);
+  for (int r = 0; r < nrows; r++) {
+    for (int c = 0; c < ncols; c++) {
+      char bl = blocks[r][c];
+      for (ind_t l = 1; l <= size[bl]; l++) {
+        auto h = hint.find(cell(r, c));
+        if (h != hint.end() && h->second != l) continue;
+        Vect1D row{ind_t(cell(r, c)), first_item[bl] + l - 1};
+        for (auto [cells, item] : pairs) {
+          if ((cells.first == cell(r, c) || cells.second == cell(r, c)) &&
+              l <= std::min(size[blocks[cells.first / ncols]
+                                       [cells.first % ncols]],
+                            size[blocks[cells.second / ncols]
+                                       [cells.second % ncols]]))
+            row.push_back(item + l - 1);
+        }
+        builder.add_row(row);
+      }
+    }
+  }
+  return builder.finalize();
+}
+
+/////////////////////////
+struct Instance {
+  std::string name;
+  std::function<DLXMatrix()> build;
+  DLXMatrix::count_t max_sols;
+  bool quick;  // in the smaller corpus
+};
+
+std::vector<Instance> corpus() {
+  static const DLXMatrix::count_t all = -1;
+  std::vector<Instance> res;
+  // Puzzles with 17 hints from Gordon Royle's list, which have a single
+  // solution: the search proves it.
+  static const std::vector<std::string> sudoku17 = {
+      "000000010400000000020000000000050407008000300001090000300400200050100000"
+      "000806000",
+      "000000010400000000020000000000050604008000300001090000300400200050100000"
+      "000807000",
+      "000000012000035000000600070700000300000400800100000000000120000080000040"
+      "050000600",
+      "000000012003600000000007000410020000000500300700000600280000040000300500"
+      "000000000",
+      "000000012008030000000000040120500000000004700060000000507000300000620000"
+      "000100000",
+  };
+  // Puzzles known to be hard for the human solvers and the backtracking
+  static const std::vector<std::string> sudoku_hard = {
+      // AI Escargot
+      "1....7.9..3..2...8..96..5....53..9...1..8...26....4...3......1..4......7"
+      "..7...3..",
+      // Easter Monster
+      "1.......2.9.4...5...6...7...5.9.3.......7.......85..4.7.....6...3...9.8"
+      "...2.....1",
+      // Arto Inkala's 2012 puzzle
+      "8..........36......7..9.2...5...7.......457.....1...3...1....68..85...1."
+      ".9....4..",
+      // From Peter Norvig's essay on solving every sudoku
+      "4.....8.5.3..........7......2.....6.....8.4......1.......6.3.7.5..2....."
+      "1.4......",
+  };
+
+  for (size_t i = 0; i < sudoku17.size(); i++)
+    res.push_back({"sudoku17-" + std::to_string(i + 1),
+                   [i] { return Sudoku9(sudoku17[i]); }, all, true});
+  for (size_t i = 0; i < sudoku_hard.size(); i++)
+    res.push_back({"sudoku-hard-" + std::to_string(i + 1),
+                   [i] { return Sudoku9(sudoku_hard[i]); }, all, true});
+  // Grids with a random fraction of the hints of a full grid, which have
+  // many solutions: the search stops at the second one.
+  res.push_back({"sudoku16-40", [] { return RandomSudoku(4, 0.40, 1); }, 2,
+                 true});
+  res.push_back({"sudoku25-50", [] { return RandomSudoku(5, 0.50, 1); }, 2,
+                 false});
+  res.push_back({"sudoku36-55", [] { return RandomSudoku(6, 0.55, 1); }, 2,
+                 false});
+  for (ind_t N = 7; N <= 13; N++)
+    res.push_back({"langford-" + std::to_string(N),
+                   [N] { return Langford_matrix(N); }, all, N <= 9});
+  for (ind_t N = 8; N <= 13; N++)
+    res.push_back({"queens-" + std::to_string(N), [N] { return Queens(N); },
+                   all, N <= 10});
+  for (auto [h, w] : {std::make_pair(3, 20), {4, 15}, {5, 12}, {6, 10}})
+    res.push_back({"pentominoes-" + std::to_string(h) + "x" + std::to_string(w),
+                   [h = h, w = w] { return Pentominoes(h, w); }, all, h == 3});
+  res.push_back({"tectonic-26_135",
+                 [] {
+                   return Tectonic({"AAABBBCCC", "AABBDDCCE", "FGGGDDDHE",
+                                    "FFGGIIHHJ", "FKKIIIHHJ"},
+                                   {{0, 1, 5}, {0, 4, 5}, {0, 7, 5}, {1, 5, 4},
+                                    {2, 2, 1}, {4, 4, 4}, {4, 7, 5}});
+                 },
+                 all, true});
+  res.push_back({"tectonic-28_151",
+                 [] {
+                   return Tectonic({"ABBBCCDDD", "AAECCFFDD", "AAECGFFFH",
+                                    "IEEGGJJHH", "IEGGJJJHH", "IKKKLLMMN",
+                                    "IKKLLLMMO", "IPPQQQQMO", "RPPQSTTTO",
+                                    "UPSSSSTOO", "UUUUVVVVV"},
+                                   {{0, 4, 1}, {0, 8, 5}, {1, 0, 4},
+                                    {1, 1, 2}, {3, 0, 2}, {3, 7, 4},
+                                    {3, 8, 5}, {6, 2, 2}, {6, 3, 3},
+                                    {8, 8, 5}, {10, 1, 4}, {10, 2, 1},
+                                    {10, 8, 5}});
+                 },
+                 all, true});
+  res.push_back({"tectonic-empty5x4",
+                 [] {
+                   return Tectonic({"AAAB", "CAAB", "CCBB", "CCDD", "EEDD"},
+                                   {});
+                 },
+                 all, true});
+  res.push_back({"tectonic-empty7x7",
+                 [] {
+                   return Tectonic({"AAACCCF", "AABBCCE", "IIHBBEE", "IIHHHEG",
+                                    "KIHMMEG", "KKKMMMG", "KXXXYYY"},
+                                   {});
+                 },
+                 all, false});
+  return res;
+}
+
+/////////////////////////
+const char *const columns =
+    "instance\tcols\trows\tentries\tbuild_ms\tsols\truns\tchoices\tdances"
+    "\ttime_s\tchoices_per_s\tdances_per_s\tns_per_dance\tpeak_rss_kb";
+
+// Returns the mean time of the search; the short searches are repeated,
+// for the timings to be significant.
+double time_search(DLXMatrix &M, DLXMatrix::count_t max_sols,
+                   DLXMatrix::count_t &nb_sols, size_t &runs) {
+  auto tstart = cron::steady_clock::now();
+  cron::steady_clock::time_point tend;
+  runs = 0;
+  do {
+    nb_sols = M.count_up_to(max_sols);
+    runs++;
+    tend = cron::steady_clock::now();
+  } while (tend - tstart < cron::milliseconds(100));
+  return cron::duration<double>(tend - tstart).count() / runs;
+}
+
+// Builds and solves the instance, and writes its line
+void run(const Instance &inst, size_t kernel) {
+  auto tstart = cron::steady_clock::now();
+  DLXMatrix M = inst.build();
+  auto tbuild = cron::steady_clock::now();
+  DLXMatrix::count_t nb_sols;
+  size_t runs;
+  double time = time_search(M, inst.max_sols, nb_sols, runs);
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  size_t entries = 0;
+  for (ind_t i = 0; i < M.nb_rows(); i++) entries += M.ith_row_sparse(i).size();
+  double build_ms = cron::duration<double, std::milli>(tbuild - tstart).count();
+  std::cout << inst.name << '\t' << M.nb_cols() << '\t' << M.nb_rows() << '\t'
+            << entries << '\t' << std::fixed << std::setprecision(3)
+            << build_ms << '\t' << count_to_string(nb_sols) << '\t' << runs
+            << '\t'
+            << M.nb_choices << '\t' << M.nb_dances << '\t'
+            << std::setprecision(9) << time << '\t' << std::setprecision(0)
+            << M.nb_choices / time << '\t' << M.nb_dances / time << '\t'
+            << std::setprecision(3)
+            << (M.nb_dances ? time * 1e9 / M.nb_dances : 0) << '\t'
+            << usage.ru_maxrss;
+  if (kernel > 0) {
+    M.set_kernel_threshold(kernel);
+    DLXMatrix::count_t kernel_sols;
+    size_t kernel_runs;
+    double kernel_time =
+        time_search(M, inst.max_sols, kernel_sols, kernel_runs);
+    if (kernel_sols != nb_sols) std::exit(EXIT_FAILURE);
+    std::cout << '\t' << std::setprecision(9) << kernel_time << '\t'
+              << std::setprecision(3) << time / kernel_time;
+  }
+  std::cout << std::endl;
+}
+
+// The time of each instance in a previous output
+std::map<std::string, double> read_baseline(const std::string &file) {
+  std::ifstream in(file);
+  if (!in) throw std::runtime_error("cannot read " + file);
+  std::map<std::string, double> res;
+  std::string line, time_s = "time_s";
+  size_t time_col = 0;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::vector<std::string> fields;
+    std::istringstream fs(line);
+    for (std::string field; std::getline(fs, field, '\t');)
+      fields.push_back(field);
+    if (fields[0] == "instance") {
+      time_col = std::find(fields.begin(), fields.end(), time_s) -
+                 fields.begin();
+    } else if (time_col > 0 && time_col < fields.size()) {
+      res[fields[0]] = std::stod(fields[time_col]);
+    }
+  }
+  return res;
+}
+
+int main(int argc, char *argv[]) {
+  bool quick = false;
+  size_t kernel = 0;
+  std::string baseline_file;
+  std::vector<std::string> prefixes;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-q") == 0) {
+      quick = true;
+    } else if (std::strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      kernel = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      baseline_file = argv[++i];
+    } else if (argv[i][0] != '-') {
+      prefixes.push_back(argv[i]);
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [-q] [-k <threshold>] [-c <baseline>] [<prefix>...]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  std::map<std::string, double> baseline;
+  if (!baseline_file.empty()) {
+    try {
+      baseline = read_baseline(baseline_file);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << columns << (kernel > 0 ? "\tkernel_time_s\tkernel_speedup" : "")
+            << (baseline.empty() ? "" : "\tbase_time_s\tspeedup") << std::endl;
+  for (const Instance &inst : corpus()) {
+    if (quick && !inst.quick) continue;
+    if (!prefixes.empty() &&
+        std::none_of(prefixes.begin(), prefixes.end(),
+                     [&inst](const std::string &p) {
+                       return inst.name.compare(0, p.size(), p) == 0;
+                     }))
+      continue;
+    // The child writes its line through a pipe, to which the comparison is
+    // appended
+    int fds[2];
+    if (pipe(fds) != 0) return EXIT_FAILURE;
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      dup2(fds[1], STDOUT_FILENO);
+      run(inst, kernel);
+      std::exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    std::string line;
+    char buf[256];
+    ssize_t nb;
+    while ((nb = read(fds[0], buf, sizeof(buf))) > 0) line.append(buf, nb);
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (line.empty() || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      std::cout << "# " << inst.name << " failed" << std::endl;
+      continue;
+    }
+    line.pop_back();  // newline
+    std::cout << line;
+    auto base = baseline.find(inst.name);
+    if (base != baseline.end()) {
+      std::vector<std::string> fields;
+      std::istringstream fs(line);
+      for (std::string field; std::getline(fs, field, '\t');)
+        fields.push_back(field);
+      double time = std::stod(fields[9]);  // time_s
+      std::cout << '\t' << std::fixed << std::setprecision(9) << base->second
+                << '\t' << std::setprecision(3) << base->second / time;
+    } else if (!baseline.empty()) {
+      std::cout << "\t\t";
+    }
+    std::cout << std::endl;
+  }
+}
@@ -0,0 +1,259 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Solver for problems in Knuth's dancing links text format
+//
+//   dancing [-a | -0 | -f | -<k>] [-r] [file]
+//
+// The problem is read on the file or on the standard input: a line of item
+// names, the secondary ones after a |, then one option per line, made of
+// item names. A secondary item may be given a color as in item:color. The
+// lines starting with | are comments. The solutions are written as
+//
+//   Solution:
+//   <option>
+//   ...
+//   End
+//
+// followed by %T statistics lines. The modes are
+//   -a   all the solutions (default)
+//   -0   count the solutions without writing them
+//   -f   the first solution only, same as -1
+//   -<k> at most k solutions
+//   -r   a random solution
+//////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "dlx_matrix.hpp"
+
+namespace cron = std::chrono;
+using namespace DLX_backtrack;
+using ind_t = DLXMatrix::ind_t;
+// The items and the options are views on the text of the problem
+using Problem = DLXMatrixIdent<std::string_view, std::string_view,
+                               FlatHashIndexer<std::string_view>>;
+
+std::string read_all(std::FILE *in) {
+  std::string res;
+  char buf[1 << 16];
+  size_t nb;
+  while ((nb = std::fread(buf, 1, sizeof(buf), in)) > 0) res.append(buf, nb);
+  if (std::ferror(in)) throw std::runtime_error("read error");
+  return res;
+}
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// Splits the line in words, which are views on it
+void split_words(std::string_view line, std::vector<std::string_view> &words) {
+  words.clear();
+  size_t i = 0;
+  for (;;) {
+    while (i < line.size() && is_space(line[i])) i++;
+    if (i == line.size()) return;
+    size_t j = i;
+    while (j < line.size() && !is_space(line[j])) j++;
+    words.push_back(line.substr(i, j - i));
+    i = j;
+  }
+}
+
+// Calls fun(line, line_nb) on the lines of text which are neither blank nor
+// comments, the newline and the surrounding spaces being removed
+template <typename Fun>
+void for_lines(std::string_view text, Fun fun) {
+  size_t line_nb = 0;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    if (end == std::string_view::npos) end = text.size();
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(std::min(end + 1, text.size()));
+    line_nb++;
+    while (!line.empty() && is_space(line.front())) line.remove_prefix(1);
+    while (!line.empty() && is_space(line.back())) line.remove_suffix(1);
+    if (line.empty() || line.front() == '|') continue;
+    fun(line, line_nb);
+  }
+}
+
+Problem parse(std::string_view text) {
+  std::vector<std::string_view> items, opts, words;
+  size_t nb_primary = 0;
+  bool secondary = false;
+  std::unordered_map<std::string_view, ind_t> colors;
+  std::vector<size_t> last_row;  // the last option of each item
+  DLXMatrixBuilder builder(0);
+  FlatHashIndexer<std::string_view> index(items);
+
+  auto error = [](size_t line_nb, const std::string &msg) {
+    return std::runtime_error("line " + std::to_string(line_nb) + ": " + msg);
+  };
+  for_lines(text, [&](std::string_view line, size_t line_nb) {
+    split_words(line, words);
+    if (items.empty()) {
+      for (std::string_view word : words) {
+        if (word == "|") {
+          secondary = true;
+        } else {
+          items.push_back(word);
+          if (!secondary) nb_primary++;
+        }
+      }
+      if (items.empty()) throw error(line_nb, "no item");
+      try {
+        index = FlatHashIndexer<std::string_view>(items);
+      } catch (const std::runtime_error &) {
+        throw error(line_nb, "duplicate item");
+      }
+      builder = DLXMatrixBuilder(items.size(), nb_primary);
+      builder.reserve(std::count(text.begin(), text.end(), '\n'), 0);
+      last_row.assign(items.size(), std::numeric_limits<size_t>::max());
+      return;
+    }
+    for (std::string_view word : words) {
+      std::string_view name = word, color;
+      size_t colon = word.find(':');
+      if (colon != std::string_view::npos) {
+        name = word.substr(0, colon);
+        color = word.substr(colon + 1);
+      }
+      ind_t col;
+      try {
+        col = index.at(name);
+      } catch (const std::out_of_range &) {
+        throw error(line_nb, "unknown item " + std::string(name));
+      }
+      // An item repeated in an option would break the links
+      if (last_row[col] == opts.size())
+        throw error(line_nb, "repeated item " + std::string(name));
+      last_row[col] = opts.size();
+      ind_t color_id = 0;
+      if (!color.empty()) {
+        if (col < nb_primary)
+          throw error(line_nb, "colored primary item " + std::string(name));
+        color_id = colors.emplace(color, colors.size() + 1).first->second;
+      }
+      builder.add_item(col, color_id);
+    }
+    builder.end_row();
+    opts.push_back(line);
+  });
+  if (items.empty()) throw std::runtime_error("no item line");
+  return Problem(std::move(items), std::move(opts), builder.finalize());
+}
+
+double elapsed_ns(cron::steady_clock::time_point start,
+                  cron::steady_clock::time_point end) {
+  return cron::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  enum { all, count, random } mode = all;
+  size_t max_sols = std::numeric_limits<size_t>::max();
+  const char *filename = nullptr;
+  auto usage = [argv]() {
+    std::cerr << "Usage: " << argv[0] << " [-a | -0 | -f | -<k>] [-r] [file]"
+              << std::endl;
+    return EXIT_FAILURE;
+  };
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (std::strcmp(arg, "-a") == 0) {
+      mode = all;
+    } else if (std::strcmp(arg, "-0") == 0) {
+      mode = count;
+    } else if (std::strcmp(arg, "-f") == 0) {
+      max_sols = 1;
+    } else if (std::strcmp(arg, "-r") == 0) {
+      mode = random;
+    } else if (arg[0] == '-' && std::isdigit(arg[1])) {
+      char *check;
+      max_sols = strtoul(arg + 1, &check, 10);
+      if (*check != '\0') return usage();
+    } else if (arg[0] != '-' && !filename) {
+      filename = arg;
+    } else {
+      return usage();
+    }
+  }
+
+  std::ios::sync_with_stdio(false);
+  auto tstart = cron::steady_clock::now();
+  std::string text;
+  Problem M;
+  try {
+    std::FILE *in = filename ? std::fopen(filename, "r") : stdin;
+    if (!in) throw std::runtime_error(std::string("cannot read ") + filename);
+    text = read_all(in);
+    if (filename) std::fclose(in);
+    M = parse(text);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  auto tparse = cron::steady_clock::now();
+
+  auto print = [](const auto &sol) {
+    std::cout << "Solution:\n";
+    for (std::string_view opt : sol) std::cout << opt << '\n';
+    std::cout << "End\n";
+  };
+  Problem::count_t nb_sols = 0;
+  double output_ns = 0;
+  if (mode == count) {
+    nb_sols = M.count_solutions();
+  } else if (mode == random) {
+    std::vector<std::string_view> sol;
+    if (M.search_random(sol)) {
+      nb_sols = 1;
+      auto tout = cron::steady_clock::now();
+      print(sol);
+      output_ns += elapsed_ns(tout, cron::steady_clock::now());
+    }
+  } else if (max_sols > 0) {
+    std::vector<std::string_view> sol;
+    M.search_visit([&](Problem::SolutionView rows) {
+      auto tout = cron::steady_clock::now();
+      sol.clear();
+      for (ind_t i : rows) sol.push_back(M.get_opt_id(i));
+      print(sol);
+      output_ns += elapsed_ns(tout, cron::steady_clock::now());
+      return ++nb_sols < max_sols;
+    });
+  }
+  auto tend = cron::steady_clock::now();
+
+  std::cout << "%T Number of solutions: " << count_to_string(nb_sols) << '\n'
+            << "%T Number of choices: " << M.nb_choices
+            << ", Number of dances: " << M.nb_dances << '\n'
+            << "%T Timings: parse = " << size_t(elapsed_ns(tstart, tparse))
+            << " ns, solve = "
+            << size_t(elapsed_ns(tparse, tend) - output_ns)
+            << " ns, output = " << size_t(output_ns)
+            << " ns, total = " << size_t(elapsed_ns(tstart, tend)) << " ns"
+            << std::endl;
+}
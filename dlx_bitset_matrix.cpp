@@ -0,0 +1,401 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Exact cover search on bitsets, for small and dense matrices.
+//////////////////////////////////////////////////////////////
+#include "dlx_bitset_matrix.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <algorithm>  // min, sort
+#include <stdexcept>  // runtime_error
+#include <vector>     // vector
+
+// The popcount kernels are compiled twice on x86-64, with and without the
+// POPCNT instruction, and the right one is selected when the program starts.
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DLX_POPCNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define DLX_POPCNT_CLONES
+#endif
+
+namespace DLX_backtrack {
+
+/////////////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_bitset_matrix]class DLXBitsetMatrix");
+/////////////////////////////////////////////////////////////
+
+using Vect1D = DLXBitsetMatrix::Vect1D;
+using Vect2D = DLXBitsetMatrix::Vect2D;
+using ind_t = DLXBitsetMatrix::ind_t;
+using word_t = DLXBitsetMatrix::word_t;
+
+class DLXBitsetMatrixFixture : public DLXTestFixture {
+ public:
+  DLXBitsetMatrixFixture() {
+    TestSample.push_back(Langford_matrix(4));
+    TestSample.push_back(Langford_matrix(7));
+  }
+};
+
+DLXBitsetMatrix::DLXBitsetMatrix(ind_t nb_col, ind_t nb_primary)
+    : nb_primary_(std::min(nb_col, nb_primary)),
+      nb_words_(0),
+      depth_(0),
+      col_rows_(nb_col),
+      active_cols_((nb_col + word_bits - 1) / word_bits, 0),
+      search_down_(true),
+      nb_choices(0),
+      nb_dances(0) {
+  for (ind_t i = 0; i < nb_col; i++)
+    active_cols_[i / word_bits] |= word_t(1) << (i % word_bits);
+}
+TEST_CASE("Constructor DLXBitsetMatrix(ind_t, ind_t)") {
+  DLXBitsetMatrix M00(0, 0);
+  CHECK(M00.nb_cols() == 0);
+  CHECK(M00.nb_primary() == 0);
+  DLXBitsetMatrix M52(5, 2);
+  CHECK(M52.nb_cols() == 5);
+  CHECK(M52.nb_primary() == 2);
+  CHECK(M52.nb_rows() == 0);
+  DLXBitsetMatrix M56(5, 6);
+  CHECK(M56.nb_primary() == 5);
+}
+
+DLXBitsetMatrix::DLXBitsetMatrix(ind_t nb_col, ind_t nb_primary,
+                                 const Vect2D &rows)
+    : DLXBitsetMatrix(nb_col, nb_primary) {
+  for (const auto &r : rows) add_row_sparse(r);
+}
+
+DLXBitsetMatrix::DLXBitsetMatrix(const DLXMatrix &M)
+    : DLXBitsetMatrix(M.nb_cols(), M.nb_primary()) {
+  if (M.has_colors())
+    throw std::runtime_error(
+        "DLXBitsetMatrix : colored items are not supported");
+  if (M.has_multiplicities())
+    throw std::runtime_error(
+        "DLXBitsetMatrix : multiplicities are not supported");
+  for (ind_t i = 0; i < M.nb_rows(); i++) add_row_sparse(M.ith_row_sparse(i));
+}
+TEST_CASE_FIXTURE(DLXBitsetMatrixFixture,
+                  "Constructor DLXBitsetMatrix(DLXMatrix)") {
+  for (const DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    DLXBitsetMatrix B(M);
+    CHECK(B.nb_cols() == M.nb_cols());
+    CHECK(B.nb_primary() == M.nb_primary());
+    REQUIRE(B.nb_rows() == M.nb_rows());
+    for (ind_t i = 0; i < M.nb_rows(); i++)
+      CHECK(B.ith_row_sparse(i) == M.ith_row_sparse(i));
+    CHECK(B.to_string() == M.to_string());
+  }
+}
+TEST_CASE("Constructor DLXBitsetMatrix(DLXMatrix) with colors or "
+          "multiplicities") {
+  DLXMatrix M(3, 1);
+  M.add_row_sparse({0, 1}, {0, 1});
+  CHECK_THROWS_WITH_AS(DLXBitsetMatrix{M},
+                       "DLXBitsetMatrix : colored items are not supported",
+                       std::runtime_error);
+  DLXMatrix N(3, 1, {{0, 1}});
+  N.set_multiplicity(0, 0, 2);
+  CHECK_THROWS_WITH_AS(DLXBitsetMatrix{N},
+                       "DLXBitsetMatrix : multiplicities are not supported",
+                       std::runtime_error);
+}
+
+ind_t DLXBitsetMatrix::add_row_sparse(const Vect1D &r) {
+  // A new word of rows would shift the saved active sets of the choices
+  if (!work_.empty())
+    throw std::runtime_error(
+        "DLXBitsetMatrix : rows must be added before any choice");
+  // Assume that the row is not empty and correct
+  ind_t row_id = rows_.size();
+  if (row_id % word_bits == 0) {
+    nb_words_++;
+    for (auto &col : col_rows_) col.push_back(0);
+    active_rows_.push_back(0);
+  }
+  word_t bit = word_t(1) << (row_id % word_bits);
+  for (ind_t c : r) col_rows_[c][row_id / word_bits] |= bit;
+  active_rows_[row_id / word_bits] |= bit;
+  rows_.push_back(r);
+  return row_id;
+}
+TEST_CASE("Method add_row_sparse") {
+  DLXBitsetMatrix M(5);
+  CHECK(M.add_row_sparse({0, 1}) == 0);
+  CHECK(M.add_row_sparse({2, 3, 4}) == 1);
+  CHECK(M.add_row({1, 2, 4}) == 2);
+  CHECK(M.nb_rows() == 3);
+  CHECK(M.ith_row_sparse(1) == Vect1D({2, 3, 4}));
+  CHECK(M.col_size(0) == 1);
+  CHECK(M.col_size(2) == 2);
+  CHECK(M.col_size(4) == 2);
+  DLXBitsetMatrix N(3);
+  for (ind_t i = 0; i < 200; i++) N.add_row({i % 3});
+  CHECK(N.col_size(0) == 67);
+  CHECK(N.col_size(1) == 67);
+  CHECK(N.col_size(2) == 66);
+  M.choose(0);
+  CHECK_THROWS_WITH_AS(M.add_row({2, 3}),
+                       "DLXBitsetMatrix : rows must be added before any choice",
+                       std::runtime_error);
+  CHECK(M.nb_rows() == 3);
+  M.reset();
+  CHECK(M.add_row({2, 3}) == 3);
+}
+
+std::string DLXBitsetMatrix::to_string() const {
+  std::string res;
+  for (const auto &row : rows_) {
+    std::vector<bool> r(nb_cols(), false);
+    for (ind_t c : row) r[c] = true;
+    res += "[" + std::to_string(static_cast<int>(r[0]));
+    for (size_t i = 1; i < r.size(); ++i) {
+      res += i == nb_primary_ ? " | " : ", ";
+      res += std::to_string(static_cast<int>(r[i]));
+    }
+    res += "]\n";
+  }
+  return res;
+}
+
+bool DLXBitsetMatrix::is_solution(const Vect1D &sol) const {
+  Vect1D cols(nb_cols());
+  for (ind_t r : sol)
+    for (ind_t c : rows_[r]) cols[c]++;
+  for (ind_t i = 0; i < nb_primary_; i++)
+    if (cols[i] != 1) return false;
+  for (ind_t i = nb_primary_; i < nb_cols(); i++)
+    if (cols[i] > 1) return false;
+  return true;
+}
+
+bool DLXBitsetMatrix::is_row_active(ind_t i) const {
+  return (active()[i / word_bits] >> (i % word_bits)) & 1;
+}
+bool DLXBitsetMatrix::is_col_active(ind_t i) const {
+  return (active_cols_[i / word_bits] >> (i % word_bits)) & 1;
+}
+DLX_POPCNT_CLONES ind_t DLXBitsetMatrix::col_size(ind_t i) const {
+  const word_t *act = active(), *col = col_rows_[i].data();
+  ind_t size = 0;
+  for (ind_t w = 0; w < nb_words_; w++)
+    size += __builtin_popcountll(col[w] & act[w]);
+  return size;
+}
+TEST_CASE_FIXTURE(DLXBitsetMatrixFixture, "Methods is_row/col_active") {
+  DLXBitsetMatrix M(6, V6_10);
+  M.choose(2);
+  CHECK(M.is_col_active(0));
+  CHECK_FALSE(M.is_col_active(1));
+  CHECK_FALSE(M.is_col_active(4));
+  for (ind_t i = 0; i < M.nb_rows(); i++) {
+    CAPTURE(i);
+    CHECK(M.is_row_active(i) == (i == 0 || i == 3 || i == 5));
+  }
+  CHECK(M.col_size(0) == 1);
+  CHECK(M.col_size(3) == 1);
+}
+
+DLX_POPCNT_CLONES void DLXBitsetMatrix::choose_row(ind_t row) {
+  nb_choices++;
+  ind_t level = work_.size() * nb_words_;
+  active_rows_.resize(level + 2 * nb_words_);
+  const word_t *cur = active_rows_.data() + level;
+  word_t *next = active_rows_.data() + level + nb_words_;
+  const Vect1D &cols = rows_[row];
+  for (ind_t w = 0; w < nb_words_; w++) {
+    word_t removed = 0;
+    for (ind_t c : cols) removed |= col_rows_[c][w];
+    removed &= cur[w];
+    next[w] = cur[w] & ~removed;
+    nb_dances += __builtin_popcountll(removed);
+  }
+  for (ind_t c : cols)
+    active_cols_[c / word_bits] &= ~(word_t(1) << (c % word_bits));
+  work_.push_back(row);
+}
+void DLXBitsetMatrix::unchoose_row() {
+  for (ind_t c : rows_[work_.back()])
+    active_cols_[c / word_bits] |= word_t(1) << (c % word_bits);
+  work_.pop_back();
+  active_rows_.resize(active_rows_.size() - nb_words_);
+}
+
+DLX_POPCNT_CLONES ind_t DLXBitsetMatrix::choose_min(ind_t &min_size) const {
+  const word_t *act = active();
+  ind_t choice = npos;
+  min_size = npos;
+  for (ind_t iw = 0; iw * word_bits < nb_primary_; iw++) {
+    word_t cols = active_cols_[iw];
+    ind_t rem = nb_primary_ - iw * word_bits;
+    if (rem < word_bits) cols &= (word_t(1) << rem) - 1;
+    while (cols != 0) {
+      ind_t c = iw * word_bits + __builtin_ctzll(cols);
+      cols &= cols - 1;
+      const word_t *col = col_rows_[c].data();
+      ind_t size = 0;
+      for (ind_t w = 0; w < nb_words_; w++)
+        size += __builtin_popcountll(col[w] & act[w]);
+      if (size < min_size) {
+        choice = c;
+        min_size = size;
+        if (size == 0) return choice;
+      }
+    }
+  }
+  return choice;
+}
+
+// First active row of column col strictly after row (npos means from start)
+ind_t DLXBitsetMatrix::next_row(ind_t col, ind_t row) const {
+  const word_t *act = active(), *rows = col_rows_[col].data();
+  ind_t start = row == npos ? 0 : row + 1;
+  for (ind_t w = start / word_bits; w < nb_words_; w++) {
+    word_t bits = rows[w] & act[w];
+    if (w == start / word_bits) bits &= ~word_t(0) << (start % word_bits);
+    if (bits != 0) return w * word_bits + __builtin_ctzll(bits);
+  }
+  return npos;
+}
+
+// Same traversal as the iterative version of DLXMatrix
+///////////////////////////////////////////////////////
+bool DLXBitsetMatrix::search_iter() {
+  while (search_down_ || work_.size() > depth_) {
+    if (search_down_) {  // going down the recursion
+      ind_t min_size;
+      ind_t col = choose_min(min_size);
+      if (col == npos) {
+        search_down_ = false;
+        return true;
+      }
+      if (min_size == 0) {
+        search_down_ = false;
+      } else {
+        branch_cols_.push_back(col);
+        choose_row(next_row(col, npos));
+      }
+    } else {  // going up the recursion
+      ind_t row = work_.back();
+      unchoose_row();
+      row = next_row(branch_cols_.back(), row);
+      if (row != npos) {
+        choose_row(row);
+        search_down_ = true;
+      } else {
+        branch_cols_.pop_back();
+      }
+    }
+  }
+  return false;
+}
+bool DLXBitsetMatrix::search_iter(Vect1D &v) {
+  bool res;
+  if ((res = search_iter())) v = get_solution();
+  return res;
+}
+TEST_CASE_FIXTURE(DLXBitsetMatrixFixture, "Method search_iter") {
+  SUBCASE("agrees with DLXMatrix") {
+    for (DLXMatrix &M : TestSample) {
+      CAPTURE(M);
+      DLXBitsetMatrix B(M);
+      Vect2D solM, solB;
+      while (M.search_iter()) solM.push_back(M.get_solution());
+      while (B.search_iter()) solB.push_back(B.get_solution());
+      CHECK(solB == solM);
+      CHECK(B.nb_choices == M.nb_choices);
+    }
+  }
+  SUBCASE("Langford numbers") {
+    CHECK(DLXBitsetMatrix(Langford_matrix(7)).search_rec().size() == 52);
+    CHECK(DLXBitsetMatrix(Langford_matrix(8)).search_rec().size() == 300);
+  }
+  SUBCASE("still work after copy") {
+    DLXBitsetMatrix M(6, V6_10);
+    REQUIRE(M.search_iter());
+    DLXBitsetMatrix N(M);
+    Vect2D solM, solN;
+    while (M.search_iter()) solM.push_back(M.get_solution());
+    while (N.search_iter()) solN.push_back(N.get_solution());
+    CHECK(solN == solM);
+    CHECK(solN.size() == 4);
+  }
+  SUBCASE("solutions are actual solutions") {
+    DLXBitsetMatrix M(10, 8, VA2AB);
+    Vect1D sol;
+    while (M.search_iter(sol)) CHECK(M.is_solution(sol));
+  }
+}
+
+Vect2D DLXBitsetMatrix::search_rec(size_t max_sol) {
+  Vect2D res{};
+  nb_choices = nb_dances = 0;
+  while (res.size() < max_sol && search_iter()) res.push_back(get_solution());
+  auto choices = nb_choices, dances = nb_dances;
+  reset(depth_);
+  nb_choices = choices;
+  nb_dances = dances;
+  return res;
+}
+TEST_CASE_FIXTURE(DLXBitsetMatrixFixture, "Method search_rec") {
+  for (DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    DLXBitsetMatrix B(M);
+    CHECK(B.search_rec() == M.search_rec());
+    CHECK(B.nb_choices == M.nb_choices);
+    CHECK(B.search_rec(1) == M.search_rec(1));
+    CHECK(B.nb_choices == M.nb_choices);
+    CHECK(B.search_rec(2) == M.search_rec(2));
+  }
+}
+
+void DLXBitsetMatrix::reset(size_t depth) {
+  nb_choices = nb_dances = 0;
+  while (work_.size() > depth) unchoose_row();
+  branch_cols_.clear();
+  search_down_ = true;
+  depth_ = work_.size();
+}
+
+ind_t DLXBitsetMatrix::choose(ind_t i) {
+  choose_row(i);
+  return ++depth_;
+}
+TEST_CASE_FIXTURE(DLXBitsetMatrixFixture, "Method choose and reset") {
+  DLXBitsetMatrix M(6, V6_10);
+  CHECK(M.choose(5) == 1);
+  CHECK(M.choose(4) == 2);
+  Vect2D solM;
+  while (M.search_iter()) solM.push_back(M.get_solution());
+  CHECK(solM == Vect2D({{5, 4, 0, 6}, {5, 4, 7}}));
+  M.reset(1);
+  solM.clear();
+  while (M.search_iter()) solM.push_back(M.get_solution());
+  CHECK(solM.size() == 4);
+  M.reset();
+  CHECK(M.search_rec().size() == 5);
+  for (ind_t i = 0; i < M.nb_cols(); i++) CHECK(M.is_col_active(i));
+}
+
+////////////////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_bitset_matrix]class DLXBitsetMatrix";
+////////////////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
@@ -0,0 +1,112 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Exact cover search on bitsets, for small and dense matrices.
+//
+// Each column is stored as the bitset of the rows it meets. The search keeps
+// a stack of bitsets of active rows: choosing a row clears all the rows which
+// meet one of its columns, and the size of a column is the popcount of its
+// bitset and-ed with the active rows. The search explores the tree in the
+// same order as DLXMatrix, so both engines give the same solutions in the
+// same order.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_BITSET_MATRIX_HPP_
+#define DLX_BITSET_MATRIX_HPP_
+
+#include <cstdint>  // uint64_t
+#include <limits>   // numeric_limits
+#include <string>   //
+#include <vector>   //
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+class DLXBitsetMatrix {
+ public:
+  using ind_t = std::size_t;
+  using word_t = std::uint64_t;
+  using Vect1D = std::vector<ind_t>;
+  using Vect2D = std::vector<Vect1D>;
+
+  static constexpr ind_t word_bits = 64;
+  static constexpr ind_t npos = std::numeric_limits<ind_t>::max();
+
+ private:
+  ind_t nb_primary_, nb_words_, depth_;
+  Vect2D rows_;
+  std::vector<std::vector<word_t>> col_rows_;  // rows meeting each column
+
+  // active_rows_ holds (work_.size() + 1) bitsets of nb_words_ words: the
+  // last one is the set of the currently active rows.
+  std::vector<word_t> active_rows_;
+  std::vector<word_t> active_cols_;
+  Vect1D work_, branch_cols_;
+  bool search_down_;
+
+ public:
+  DLXBitsetMatrix() : DLXBitsetMatrix(0) {}
+  explicit DLXBitsetMatrix(ind_t nb_col) : DLXBitsetMatrix(nb_col, nb_col) {}
+  DLXBitsetMatrix(ind_t nb_col, ind_t nb_primary);
+  DLXBitsetMatrix(ind_t nb_col, const Vect2D &rows)
+      : DLXBitsetMatrix(nb_col, nb_col, rows) {}
+  DLXBitsetMatrix(ind_t nb_col, ind_t nb_primary, const Vect2D &rows);
+  explicit DLXBitsetMatrix(const DLXMatrix &M);
+
+  size_t nb_cols() const { return col_rows_.size(); }
+  size_t nb_rows() const { return rows_.size(); }
+  size_t nb_primary() const { return nb_primary_; }
+
+  // Rows must be added before any choice is made, otherwise it throws.
+  ind_t add_row(const Vect1D &r) { return add_row_sparse(r); }
+  ind_t add_row_sparse(const Vect1D &r);
+  Vect1D ith_row_sparse(ind_t i) const { return rows_[i]; }
+
+  ind_t choose(ind_t i);
+
+  Vect2D search_rec(size_t max_sol = std::numeric_limits<size_t>::max());
+  bool search_iter();
+  bool search_iter(Vect1D &);
+  Vect1D get_solution() const { return work_; }
+  bool is_solution(const Vect1D &) const;
+
+  bool is_row_active(ind_t i) const;
+  bool is_col_active(ind_t i) const;
+  ind_t col_size(ind_t i) const;
+
+  void reset(size_t depth = 0);
+
+  std::string to_string() const;
+
+  // nb_dances counts the rows removed from the active set
+  unsigned long int nb_choices, nb_dances;  // Computation statistics
+
+ private:
+  const word_t *active() const {
+    return active_rows_.data() + work_.size() * nb_words_;
+  }
+  ind_t choose_min(ind_t &min_size) const;
+  ind_t next_row(ind_t col, ind_t row) const;
+  void choose_row(ind_t row);
+  void unchoose_row();
+};
+
+inline std::ostream &operator<<(std::ostream &out, const DLXBitsetMatrix &M) {
+  return out << M.to_string();
+}
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_BITSET_MATRIX_HPP_
@@ -0,0 +1,37 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Classical exact cover problems shared by the tests, tools and benchmarks
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_EXAMPLES_HPP_
+#define DLX_EXAMPLES_HPP_
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+// Langford pairings of 1, 1, ..., N, N: the items are the N numbers, then
+// the 2N positions
+inline DLXMatrix Langford_matrix(DLXMatrix::ind_t N) {
+  DLXMatrixBuilder builder(3 * N);
+  for (DLXMatrix::ind_t i = 1; i <= N; i++)
+    for (DLXMatrix::ind_t pos = 1; pos + i + 1 <= 2 * N; pos++)
+      builder.add_row({i - 1, N + pos - 1, N + pos + i});
+  return builder.finalize();
+}
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_EXAMPLES_HPP_
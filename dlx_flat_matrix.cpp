@@ -0,0 +1,540 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Dancing links on a single contiguous node arena addressed by indices
+//////////////////////////////////////////////////////////////////////
+#include "dlx_flat_matrix.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <algorithm>  // upper_bound, sort
+#include <stdexcept>  // length_error, runtime_error
+#include <vector>     // vector
+
+namespace DLX_backtrack {
+
+/////////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_flat_matrix]class DLXFlatMatrix");
+/////////////////////////////////////////////////////////
+
+using Vect1D = DLXMatrix::Vect1D;
+using Vect2D = DLXMatrix::Vect2D;
+using ind_t = DLXMatrix::ind_t;
+
+static Vect2D normalize_solutions(Vect2D sols) {
+  for (auto &sol : sols) std::sort(sol.begin(), sol.end());
+  std::sort(sols.begin(), sols.end());
+  return sols;
+}
+
+template <typename Index>
+DLXFlatMatrix<Index>::DLXFlatMatrix(ind_t nb_col, ind_t nb_primary)
+    : nb_primary_(std::min(nb_col, nb_primary)),
+      depth_(0),
+      shape_(std::make_shared<Shape>()),
+      links_(nb_col + 2),
+      items_(nb_col + 2, {0, 0, 0}),
+      search_down_(true),
+      nb_choices(0),
+      nb_dances(0) {
+  if (nb_col + 2 > max_nodes())
+    throw std::length_error("DLXFlatMatrix : too many columns");
+  std::vector<Index> &top = shape_->top;
+  top.assign(nb_col + 2, 0);
+  top_ = top.data();
+  for (ind_t i = 0; i <= nb_col; i++) {
+    top[i] = i;
+    links_[i].up = links_[i].down = i;
+  }
+  // Spacer before the first row
+  links_[nb_col + 1].up = links_[nb_col + 1].down = 0;
+
+  ind_t sec_root = nb_col + 1;
+  for (ind_t i = 0; i <= nb_primary_; i++) {
+    items_[i].left = i == 0 ? nb_primary_ : i - 1;
+    items_[i].right = i == nb_primary_ ? 0 : i + 1;
+  }
+  items_[sec_root].left = nb_primary_ == nb_col ? sec_root : nb_col;
+  items_[sec_root].right = nb_primary_ == nb_col ? sec_root : nb_primary_ + 1;
+  for (ind_t i = nb_primary_ + 1; i <= nb_col; i++) {
+    items_[i].left = i == nb_primary_ + 1 ? sec_root : i - 1;
+    items_[i].right = i == nb_col ? sec_root : i + 1;
+  }
+}
+TEST_CASE("Constructor DLXFlatMatrix(ind_t, ind_t)") {
+  DLXFlatMatrix32 M00(0, 0);
+  CHECK(M00.nb_cols() == 0);
+  CHECK(M00.nb_primary() == 0);
+  DLXFlatMatrix32 M52(5, 2);
+  CHECK(M52.nb_cols() == 5);
+  CHECK(M52.nb_primary() == 2);
+  CHECK(M52.nb_rows() == 0);
+  CHECK_NOTHROW(M52.check_sizes());
+  DLXFlatMatrix32 M56(5, 6);
+  CHECK(M56.nb_primary() == 5);
+  CHECK_THROWS_AS(DLXFlatMatrix16(70000), std::length_error);
+}
+
+template <typename Index>
+DLXFlatMatrix<Index>::DLXFlatMatrix(ind_t nb_col, ind_t nb_primary,
+                                    const Vect2D &rows)
+    : DLXFlatMatrix(nb_col, nb_primary) {
+  for (const auto &r : rows) add_row_sparse(r);
+}
+
+template <typename Index>
+DLXFlatMatrix<Index>::DLXFlatMatrix(const DLXMatrix &M)
+    : DLXFlatMatrix(M.nb_cols(), M.nb_primary()) {
+  if (M.has_colors())
+    throw std::runtime_error("DLXFlatMatrix : colored items are not supported");
+  if (M.has_multiplicities())
+    throw std::runtime_error(
+        "DLXFlatMatrix : multiplicities are not supported");
+  for (ind_t i = 0; i < M.nb_rows(); i++) add_row_sparse(M.ith_row_sparse(i));
+}
+TEST_CASE_FIXTURE(DLXTestFixture,
+                  "Constructor DLXFlatMatrix(DLXMatrix)") {
+  for (const DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    DLXFlatMatrix32 F(M);
+    CHECK(F.nb_cols() == M.nb_cols());
+    CHECK(F.nb_primary() == M.nb_primary());
+    REQUIRE(F.nb_rows() == M.nb_rows());
+    for (ind_t i = 0; i < M.nb_rows(); i++)
+      CHECK(F.ith_row_sparse(i) == M.ith_row_sparse(i));
+    CHECK(F.to_string() == M.to_string());
+    CHECK_NOTHROW(F.check_sizes());
+  }
+}
+TEST_CASE("Constructor DLXFlatMatrix(DLXMatrix) with colors, multiplicities") {
+  DLXMatrix M(3, 1);
+  M.add_row_sparse({0, 1}, {0, 1});
+  CHECK_THROWS_WITH_AS(DLXFlatMatrix32{M},
+                       "DLXFlatMatrix : colored items are not supported",
+                       std::runtime_error);
+  DLXMatrix N(3, 1, {{0, 1}});
+  N.set_multiplicity(0, 0, 2);
+  CHECK_THROWS_WITH_AS(DLXFlatMatrix32{N},
+                       "DLXFlatMatrix : multiplicities are not supported",
+                       std::runtime_error);
+}
+
+template <typename Index>
+ind_t DLXFlatMatrix<Index>::add_row_sparse(const Vect1D &r) {
+  // Assume that the row is not empty and correct
+  if (nb_nodes() + r.size() + 1 > max_nodes())
+    throw std::length_error("DLXFlatMatrix : index overflow");
+
+  if (shape_.use_count() > 1) shape_ = std::make_shared<Shape>(*shape_);
+  std::vector<Index> &top = shape_->top;
+  ind_t row_id = shape_->row_start.size();
+  Index first = top.size();
+  shape_->row_start.push_back(first);
+  for (ind_t c : r) {
+    Index item = c + 1, nd = top.size();
+    top.push_back(item);
+    links_.push_back({links_[item].up, item});
+    links_[links_[item].up].down = nd;
+    links_[item].up = nd;
+    items_[item].len++;
+  }
+  links_[first - 1].down = top.size() - 1;  // previous spacer
+  top.push_back(0);
+  top_ = top.data();
+  links_.push_back({first, 0});
+  return row_id;
+}
+TEST_CASE("Method add_row_sparse") {
+  DLXFlatMatrix16 M(5);
+  CHECK(M.add_row_sparse({0, 1}) == 0);
+  CHECK(M.add_row_sparse({2, 3, 4}) == 1);
+  CHECK(M.add_row({1, 2, 4}) == 2);
+  CHECK(M.nb_rows() == 3);
+  CHECK(M.nb_nodes() == 7 + 3 + 8);
+  CHECK_NOTHROW(M.check_sizes());
+  CHECK(M.ith_row_sparse(0) == Vect1D({0, 1}));
+  CHECK(M.ith_row_sparse(1) == Vect1D({2, 3, 4}));
+  CHECK(M.ith_row_sparse(2) == Vect1D({1, 2, 4}));
+}
+TEST_CASE("Method add_row_sparse: index overflow") {
+  DLXFlatMatrix16 M(100);
+  Vect1D row(100);
+  for (ind_t i = 0; i < 100; i++) row[i] = i;
+  while (M.nb_nodes() + row.size() + 1 <= M.max_nodes()) M.add_row(row);
+  ind_t nrows = M.nb_rows();
+  CHECK_THROWS_AS(M.add_row(row), std::length_error);
+  CHECK(M.nb_rows() == nrows);
+  CHECK_NOTHROW(M.check_sizes());
+}
+
+template <typename Index>
+Vect1D DLXFlatMatrix<Index>::ith_row_sparse(ind_t i) const {
+  Vect1D res;
+  for (Index q = shape_->row_start[i]; top_[q] != 0; q++)
+    res.push_back(top_[q] - 1);
+  return res;
+}
+
+template <typename Index>
+ind_t DLXFlatMatrix<Index>::get_row_id(Index nd) const {
+  const std::vector<Index> &row_start = shape_->row_start;
+  auto it = std::upper_bound(row_start.cbegin(), row_start.cend(), nd);
+  return std::distance(row_start.cbegin(), it) - 1;
+}
+
+template <typename Index>
+void DLXFlatMatrix<Index>::check_sizes() const {
+  for (ind_t root : {ind_t(0), nb_cols() + 1}) {
+    for (Index h = items_[root].right; h != root; h = items_[h].right) {
+      ind_t irows = 0;
+      for (Index p = links_[h].down; p != h; p = links_[p].down) irows++;
+      if (items_[h].len != irows)
+        throw std::runtime_error("check_size : size missmatch !");
+    }
+  }
+}
+
+template <typename Index>
+std::string DLXFlatMatrix<Index>::to_string() const {
+  std::string res;
+  for (ind_t i = 0; i < nb_rows(); i++) {
+    std::vector<bool> r(nb_cols(), false);
+    for (ind_t c : ith_row_sparse(i)) r[c] = true;
+    res += "[" + std::to_string(static_cast<int>(r[0]));
+    for (size_t i = 1; i < r.size(); ++i) {
+      res += i == nb_primary_ ? " | " : ", ";
+      res += std::to_string(static_cast<int>(r[i]));
+    }
+    res += "]\n";
+  }
+  return res;
+}
+TEST_CASE("Method to_string") {
+  DLXFlatMatrix32 M(5, 3, {{0, 1}, {2}, {2, 3, 4}, {1, 2, 4}});
+  CHECK(M.to_string() ==
+        "[1, 1, 0 | 0, 0]\n"
+        "[0, 0, 1 | 0, 0]\n"
+        "[0, 0, 1 | 1, 1]\n"
+        "[0, 1, 1 | 0, 1]\n");
+}
+
+template <typename Index>
+bool DLXFlatMatrix<Index>::is_solution(const Vect1D &sol) const {
+  Vect1D cols(nb_cols());
+  for (ind_t r : sol)
+    for (ind_t c : ith_row_sparse(r)) cols[c]++;
+  for (ind_t i = 0; i < nb_primary_; i++)
+    if (cols[i] != 1) return false;
+  for (ind_t i = nb_primary_; i < nb_cols(); i++)
+    if (cols[i] > 1) return false;
+  return true;
+}
+
+template <typename Index>
+inline void DLXFlatMatrix<Index>::hide(Index row) {
+  Index q = row + 1;
+  for (; top_[q] != 0; q++) {
+    Index u = links_[q].up, d = links_[q].down;
+    links_[u].down = d;
+    links_[d].up = u;
+    items_[top_[q]].len--;
+    nb_dances++;
+  }
+  for (q = links_[q].up; q != row; q++) {
+    Index u = links_[q].up, d = links_[q].down;
+    links_[u].down = d;
+    links_[d].up = u;
+    items_[top_[q]].len--;
+    nb_dances++;
+  }
+}
+template <typename Index>
+inline void DLXFlatMatrix<Index>::cover(Index col) {
+  Index l = items_[col].left, r = items_[col].right;
+  items_[l].right = r;
+  items_[r].left = l;
+  for (Index row = links_[col].down; row != col; row = links_[row].down)
+    hide(row);
+}
+template <typename Index>
+inline void DLXFlatMatrix<Index>::choose_node(Index nd) {
+  nb_choices++;
+  work_.push_back(nd);
+  Index q = nd + 1;
+  for (; top_[q] != 0; q++) cover(top_[q]);
+  for (q = links_[q].up; q != nd; q++) cover(top_[q]);
+}
+
+template <typename Index>
+inline void DLXFlatMatrix<Index>::unhide(Index row) {
+  Index q = row - 1;
+  for (; top_[q] != 0; q--) {
+    Index u = links_[q].up, d = links_[q].down;
+    items_[top_[q]].len++;
+    links_[u].down = q;
+    links_[d].up = q;
+  }
+  for (q = links_[q].down; q != row; q--) {
+    Index u = links_[q].up, d = links_[q].down;
+    items_[top_[q]].len++;
+    links_[u].down = q;
+    links_[d].up = q;
+  }
+}
+template <typename Index>
+inline void DLXFlatMatrix<Index>::uncover(Index col) {
+  Index l = items_[col].left, r = items_[col].right;
+  items_[l].right = col;
+  items_[r].left = col;
+  for (Index row = links_[col].up; row != col; row = links_[row].up)
+    unhide(row);
+}
+template <typename Index>
+inline void DLXFlatMatrix<Index>::unchoose_node(Index nd) {
+  Index q = nd - 1;
+  for (; top_[q] != 0; q--) uncover(top_[q]);
+  for (q = links_[q].down; q != nd; q--) uncover(top_[q]);
+  work_.pop_back();
+}
+
+template <typename Index>
+Index DLXFlatMatrix<Index>::choose_min() const {
+  Index choice = items_[0].right;
+  Index min_size = items_[choice].len;
+  for (Index h = items_[choice].right; h != 0; h = items_[h].right) {
+    if (items_[h].len < min_size) {
+      choice = h;
+      min_size = items_[h].len;
+    }
+  }
+  return choice;
+}
+
+// Knuth dancing links search algorithm
+// Recusive version
+///////////////////////////////////////
+template <typename Index>
+Vect2D DLXFlatMatrix<Index>::search_rec(size_t max_sol) {
+  Vect2D res{};
+  nb_choices = nb_dances = 0;
+  search_rec_internal(max_sol, res);
+  return res;
+}
+template <typename Index>
+void DLXFlatMatrix<Index>::search_rec_internal(size_t max_sol, Vect2D &res) {
+  if (items_[0].right == 0) {
+    res.push_back(get_solution());
+    return;
+  }
+
+  Index choice = choose_min();
+  if (items_[choice].len == 0) return;
+
+  cover(choice);
+  for (Index row = links_[choice].down; row != choice;
+       row = links_[row].down) {
+    choose_node(row);
+    search_rec_internal(max_sol, res);
+    unchoose_node(row);
+    if (res.size() >= max_sol) break;
+  }
+  uncover(choice);
+}
+TEST_CASE_FIXTURE(DLXTestFixture, "Method search_rec") {
+  for (DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    DLXFlatMatrix32 F(M);
+    CHECK(F.search_rec() == M.search_rec());
+    CHECK(F.nb_choices == M.nb_choices);
+    CHECK(F.nb_dances == M.nb_dances);
+    CHECK(F.search_rec(1) == M.search_rec(1));
+    CHECK_NOTHROW(F.check_sizes());
+  }
+}
+
+// Knuth dancing links search algorithm
+// Iterative version
+///////////////////////////////////////
+template <typename Index>
+bool DLXFlatMatrix<Index>::search_iter() {
+  while (search_down_ || work_.size() > depth_) {
+    if (search_down_) {  // going down the recursion
+      if (items_[0].right == 0) {
+        search_down_ = false;
+        return true;
+      }
+      Index choice = choose_min();
+      if (items_[choice].len == 0) {
+        search_down_ = false;
+      } else {
+        cover(choice);
+        choose_node(links_[choice].down);
+      }
+    } else {  // going up the recursion
+      Index row = work_.back();
+      Index choice = top_[row];
+      unchoose_node(row);
+      row = links_[row].down;
+      if (row != choice) {
+        choose_node(row);
+        search_down_ = true;
+      } else {
+        uncover(choice);
+      }
+    }
+  }
+  return false;
+}
+template <typename Index>
+bool DLXFlatMatrix<Index>::search_iter(Vect1D &v) {
+  bool res;
+  if ((res = search_iter())) v = get_solution();
+  return res;
+}
+TEST_CASE_FIXTURE(DLXTestFixture, "Method search_iter") {
+  SUBCASE("agrees with DLXMatrix") {
+    for (DLXMatrix &M : TestSample) {
+      CAPTURE(M);
+      DLXFlatMatrix16 F(M);
+      Vect2D solM, solF;
+      while (M.search_iter()) solM.push_back(M.get_solution());
+      while (F.search_iter()) solF.push_back(F.get_solution());
+      CHECK(solF == solM);
+      CHECK(F.nb_choices == M.nb_choices);
+      CHECK(F.nb_dances == M.nb_dances);
+      CHECK_NOTHROW(F.check_sizes());
+    }
+  }
+  SUBCASE("still work after copy") {
+    DLXFlatMatrix32 M(6, V6_10);
+    REQUIRE(M.search_iter());
+    DLXFlatMatrix32 N(M);
+    Vect2D solM, solN;
+    while (M.search_iter()) solM.push_back(M.get_solution());
+    while (N.search_iter()) solN.push_back(N.get_solution());
+    CHECK(solN == solM);
+    CHECK(solN.size() == 4);
+  }
+  SUBCASE("solutions are actual solutions") {
+    DLXFlatMatrix32 M(10, 8, VA2AB);
+    Vect1D sol;
+    while (M.search_iter(sol)) CHECK(M.is_solution(sol));
+  }
+}
+
+template <typename Index>
+Vect1D DLXFlatMatrix<Index>::get_solution() const {
+  Vect1D res;
+  res.reserve(work_.size());
+  for (Index nd : work_) res.push_back(get_row_id(nd));
+  return res;
+}
+
+template <typename Index>
+void DLXFlatMatrix<Index>::reset(size_t depth) {
+  nb_choices = nb_dances = 0;
+  while (work_.size() > depth) {
+    Index row = work_.back();
+    unchoose_node(row);
+    uncover(top_[row]);
+  }
+  search_down_ = true;
+  depth_ = work_.size();
+}
+
+template <typename Index>
+ind_t DLXFlatMatrix<Index>::choose(ind_t i) {
+  Index nd = shape_->row_start[i];
+  cover(top_[nd]);
+  choose_node(nd);
+  return ++depth_;
+}
+TEST_CASE_FIXTURE(DLXTestFixture, "Method choose and reset") {
+  DLXFlatMatrix32 M(6, V6_10);
+  CHECK(M.choose(5) == 1);
+  CHECK(M.choose(4) == 2);
+  Vect2D solM;
+  while (M.search_iter()) solM.push_back(M.get_solution());
+  CHECK(normalize_solutions(solM) == Vect2D({{0, 4, 5, 6}, {4, 5, 7}}));
+  M.reset(1);
+  solM.clear();
+  while (M.search_iter()) solM.push_back(M.get_solution());
+  CHECK(normalize_solutions(solM) ==
+        Vect2D({{0, 2, 3, 5}, {0, 4, 5, 6}, {1, 5, 8}, {4, 5, 7}}));
+  M.reset();
+  CHECK_NOTHROW(M.check_sizes());
+  CHECK(M.search_rec().size() == 5);
+}
+
+TEST_CASE("Copies share the shape") {
+  DLXFlatMatrix32 M(6, {{0, 2}, {0, 1}, {1, 4}, {3}, {3, 4}, {5}});
+  DLXFlatMatrix32 N(M);
+  CHECK(N.shares_shape(M));
+  N.add_row({1, 2, 3});  // copy on write
+  CHECK(!N.shares_shape(M));
+  CHECK(M.nb_rows() == 6);
+  CHECK(N.nb_rows() == 7);
+  CHECK(N.ith_row_sparse(6) == Vect1D({1, 2, 3}));
+  CHECK(M.ith_row_sparse(5) == Vect1D({5}));
+  CHECK_NOTHROW(M.check_sizes());
+  CHECK_NOTHROW(N.check_sizes());
+  CHECK(normalize_solutions(M.search_rec()) == Vect2D({{0, 2, 3, 5}}));
+  // The new row doesn't lead to a solution
+  CHECK(normalize_solutions(N.search_rec()) == Vect2D({{0, 2, 3, 5}}));
+  CHECK(N.nb_choices > M.nb_choices);
+}
+
+TEST_CASE_FIXTURE(DLXTestFixture, "Class DLXFlatProblem") {
+  for (DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    const DLXFlatProblem32 P(M);
+    CHECK(P.nb_rows() == M.nb_rows());
+    Vect2D solM = M.search_rec();
+    DLXFlatMatrix32 I1 = P.instance(), I2 = P.instance();
+    CHECK(I1.shares_shape(I2));
+    // Interleaved searches
+    Vect2D sol1, sol2;
+    bool more1 = true, more2 = true;
+    while (more1 || more2) {
+      if (more1 && (more1 = I1.search_iter()))
+        sol1.push_back(I1.get_solution());
+      if (more2 && (more2 = I2.search_iter()))
+        sol2.push_back(I2.get_solution());
+    }
+    CHECK(sol1 == solM);
+    CHECK(sol2 == solM);
+    CHECK(P.instance().search_rec() == solM);
+  }
+  // The choices of the matrix are undone
+  DLXFlatMatrix32 F(6, V6_10);
+  F.choose(5);
+  DLXFlatProblem32 P(std::move(F));
+  CHECK(P.instance().search_rec().size() == 5);
+  DLXFlatMatrix32 I = P.instance();
+  I.choose(5);
+  I.choose(4);
+  CHECK(I.search_rec().size() == 2);
+  CHECK(P.instance().search_rec().size() == 5);
+}
+
+template class DLXFlatMatrix<std::uint16_t>;
+template class DLXFlatMatrix<std::uint32_t>;
+
+//////////////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_flat_matrix]class DLXFlatMatrix";
+//////////////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
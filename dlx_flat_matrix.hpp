@@ -0,0 +1,175 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Dancing links on a single contiguous node arena addressed by indices
+// (in the style of Knuth's DLX1). The index width is a template parameter
+// so that small problems can use 16 bits indices and large ones 32 bits.
+//
+// The item of each node and the start of each row never change during the
+// search; they are shared between the copies of a matrix, which only own
+// the links and the sizes. A DLXFlatProblem is a read-only matrix from which
+// many such cheap search instances are made, possibly by many threads.
+//////////////////////////////////////////////////////////////////////////
+#ifndef DLX_FLAT_MATRIX_HPP_
+#define DLX_FLAT_MATRIX_HPP_
+
+#include <cstdint>      // uint16_t, uint32_t
+#include <limits>       // numeric_limits
+#include <memory>       // shared_ptr
+#include <string>       //
+#include <type_traits>  // is_unsigned
+#include <vector>       //
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+template <typename Index>
+class DLXFlatMatrix {
+  static_assert(std::is_unsigned<Index>::value,
+                "DLXFlatMatrix index type should be unsigned");
+
+ public:
+  using ind_t = std::size_t;
+  using index_t = Index;
+
+ private:
+  // Node 0 is unused, nodes 1..nb_cols are the column headers, then come
+  // the rows, each one followed by a spacer node. A spacer is recognized by
+  // its top being 0: its up link points to the first node of the previous
+  // row and its down link to the last node of the next one.
+  struct Link {
+    Index up, down;
+  };
+  struct Item {
+    Index left, right, len;
+  };
+
+  // Shared by the copies, copied by add_row_sparse if needed
+  struct Shape {
+    std::vector<Index> top, row_start;
+  };
+
+  ind_t nb_primary_, depth_;
+  std::shared_ptr<Shape> shape_;
+  const Index *top_;  // shape_->top.data()
+  std::vector<Link> links_;
+  // items_[0] is the root of primary columns, items_[nb_cols + 1] the root
+  // of secondary columns.
+  std::vector<Item> items_;
+
+  std::vector<Index> work_;
+  bool search_down_;
+
+ public:
+  using Vect1D = std::vector<ind_t>;
+  using Vect2D = std::vector<Vect1D>;
+
+  DLXFlatMatrix() : DLXFlatMatrix(0) {}
+  explicit DLXFlatMatrix(ind_t nb_col) : DLXFlatMatrix(nb_col, nb_col) {}
+  DLXFlatMatrix(ind_t nb_col, ind_t nb_primary);
+  DLXFlatMatrix(ind_t nb_col, const Vect2D &rows)
+      : DLXFlatMatrix(nb_col, nb_col, rows) {}
+  DLXFlatMatrix(ind_t nb_col, ind_t nb_primary, const Vect2D &rows);
+  explicit DLXFlatMatrix(const DLXMatrix &M);
+
+  size_t nb_cols() const { return items_.size() - 2; }
+  size_t nb_rows() const { return shape_->row_start.size(); }
+  size_t nb_primary() const { return nb_primary_; }
+  size_t nb_nodes() const { return shape_->top.size(); }
+  static constexpr size_t max_nodes() {
+    return std::numeric_limits<Index>::max();
+  }
+
+  void check_sizes() const;
+  bool shares_shape(const DLXFlatMatrix &other) const {
+    return shape_ == other.shape_;
+  }
+
+  ind_t add_row(const Vect1D &r) { return add_row_sparse(r); }
+  ind_t add_row_sparse(const Vect1D &r);
+  Vect1D ith_row_sparse(ind_t i) const;
+
+  ind_t choose(ind_t i);
+
+  Vect2D search_rec(size_t max_sol = std::numeric_limits<size_t>::max());
+  bool search_iter();
+  bool search_iter(Vect1D &);
+  Vect1D get_solution() const;
+  bool is_solution(const Vect1D &) const;
+
+  void reset(size_t depth = 0);
+
+  std::string to_string() const;
+
+  unsigned long int nb_choices, nb_dances;  // Computation statistics
+
+ private:
+  ind_t get_row_id(Index nd) const;
+
+  Index choose_min() const;
+  DLX_INLINE void hide(Index row);
+  DLX_INLINE void unhide(Index row);
+  DLX_INLINE void cover(Index col);
+  DLX_INLINE void uncover(Index col);
+  DLX_INLINE void choose_node(Index nd);
+  DLX_INLINE void unchoose_node(Index nd);
+  void search_rec_internal(size_t, Vect2D &);
+};
+
+// An instance only copies the links and the sizes: for the 2916 nodes of a
+// 9x9 sudoku with 16 bits indices, it takes about 0.3us.
+template <typename Index>
+class DLXFlatProblem {
+  DLXFlatMatrix<Index> root_;
+
+ public:
+  using ind_t = typename DLXFlatMatrix<Index>::ind_t;
+
+  // The problem is M at its root; the choices of M are undone.
+  explicit DLXFlatProblem(DLXFlatMatrix<Index> M) : root_(std::move(M)) {
+    root_.reset();
+  }
+  explicit DLXFlatProblem(const DLXMatrix &M) : root_(M) {}
+
+  size_t nb_cols() const { return root_.nb_cols(); }
+  size_t nb_rows() const { return root_.nb_rows(); }
+  size_t nb_primary() const { return root_.nb_primary(); }
+  size_t nb_nodes() const { return root_.nb_nodes(); }
+  typename DLXFlatMatrix<Index>::Vect1D ith_row_sparse(ind_t i) const {
+    return root_.ith_row_sparse(i);
+  }
+
+  // A new search at the root of the problem, independent of the others
+  DLXFlatMatrix<Index> instance() const { return root_; }
+};
+
+using DLXFlatMatrix16 = DLXFlatMatrix<std::uint16_t>;
+using DLXFlatMatrix32 = DLXFlatMatrix<std::uint32_t>;
+using DLXFlatProblem16 = DLXFlatProblem<std::uint16_t>;
+using DLXFlatProblem32 = DLXFlatProblem<std::uint32_t>;
+
+extern template class DLXFlatMatrix<std::uint16_t>;
+extern template class DLXFlatMatrix<std::uint32_t>;
+
+template <typename Index>
+inline std::ostream &operator<<(std::ostream &out,
+                                const DLXFlatMatrix<Index> &M) {
+  return out << M.to_string();
+}
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_FLAT_MATRIX_HPP_
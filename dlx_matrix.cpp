@@ -17,15 +17,24 @@
 //////////////////////////////////////////////////////////////
 #include "dlx_matrix.hpp"
 
+#include "dlx_test_fixtures.hpp"
 #include "doctest_ext.hpp"
+#include "hash_tuple.hpp"
 
-#include <algorithm>  // sort, transform, shuffle
+#include <algorithm>  // sort, transform, shuffle, unique
+#include <array>      // array
+#include <cstdint>    // uint64_t
 #include <iostream>   // cout, cin, ...
+#include <deque>      // deque
 #include <limits>     // numeric_limits
+#include <map>        // map
 #include <numeric>    // iota
+#include <optional>   // optional
 #include <random>     // default_random_engine
+#include <set>        // set
 #include <sstream>    // ostringstream
 #include <stdexcept>  // out_of_range
+#include <string>     // string
 #include <vector>     // vector
 
 namespace DLX_backtrack {
@@ -33,6 +42,7 @@ namespace DLX_backtrack {
 using Vect1D = DLXMatrix::Vect1D;
 using Vect2D = DLXMatrix::Vect2D;
 using ind_t = DLXMatrix::ind_t;
+using count_t = DLXMatrix::count_t;
 
 /////////////////////////////////////////
 TEST_SUITE_END();  // [dlx_matrix]Errors;
@@ -44,6 +54,43 @@ Vect1D inverse_perm(const Vect1D &perm) {
   return inv;
 }
 
+std::string count_to_string(count_t count) {
+  std::string res;
+  do {
+    res += static_cast<char>('0' + count % 10);
+    count /= 10;
+  } while (count != 0);
+  return std::string(res.rbegin(), res.rend());
+}
+count_t count_from_string(const std::string &str) {
+  if (str.empty()) throw std::runtime_error("count_from_string : empty count");
+  count_t res = 0;
+  for (char c : str) {
+    if (c < '0' || c > '9')
+      throw std::runtime_error("count_from_string : bad count " + str);
+    res = res * 10 + (c - '0');
+  }
+  return res;
+}
+TEST_CASE("[dlx_matrix]Function count_to_string") {
+  CHECK(count_to_string(0) == "0");
+  CHECK(count_to_string(7) == "7");
+  CHECK(count_to_string(1234567890) == "1234567890");
+  CHECK(count_to_string(std::numeric_limits<uint64_t>::max()) ==
+        "18446744073709551615");
+  CHECK(count_to_string(count_t(std::numeric_limits<uint64_t>::max()) * 1000 +
+                        999) == "18446744073709551615999");
+}
+
+TEST_CASE("[dlx_matrix]Function count_from_string") {
+  CHECK(count_from_string("0") == 0);
+  CHECK(count_from_string("1234567890") == 1234567890);
+  CHECK(count_from_string("18446744073709551615999") ==
+        count_t(std::numeric_limits<uint64_t>::max()) * 1000 + 999);
+  CHECK_THROWS_AS(count_from_string(""), std::runtime_error);
+  CHECK_THROWS_AS(count_from_string("12a"), std::runtime_error);
+}
+
 TEST_CASE("[dlx_matrix]Function inverse_perm") {
   CHECK(inverse_perm({}) == Vect1D({}));
   CHECK(inverse_perm({0}) == Vect1D{0});
@@ -59,48 +106,37 @@ TEST_CASE("[dlx_matrix]Function inverse_perm") {
 TEST_SUITE_BEGIN("[dlx_matrix]class DLXMatrix");
 ////////////////////////////////////////////////
 
-class DLXMatrixFixture {
+// Named handles on the matrices of TestSample, and a colored one
+class DLXMatrixFixture : public DLXTestFixture {
  public:
   // clang-format off
-    DLXMatrixFixture() :
-// MA2AB
-//     0 1 2 3 4 5 6 7 8 9
-//  0 [1 0 0 0 1 0 0 0 0 0]
-//  1 [1 0 0 0 0 1 0 0 0 0]
-//  2 [1 0 0 0 0 0 1 0 0 0]
-//  3 [0 1 0 0 1 0 0 0 0 0]
-//  4 [0 1 0 0 0 1 0 0 0 0]
-//  5 [0 1 0 0 0 0 1 0 0 0]
-//  6 [0 0 1 0 1 0 0 0 0 1]
-//  7 [0 0 1 0 0 1 0 0 0 0]
-//  8 [0 0 1 0 0 0 1 0 0 0]
-//  9 [0 0 0 1 0 0 0 1 0 1]
-// 10 [0 1 0 0 0 1 0 0 1 0]
-        VA2AB{{0, 4}, {0, 5}, {0, 6}, {1, 4}, {1, 5}, {1, 6},
-              {2, 4, 9}, {2, 5}, {2, 6}, {3, 7, 9}, {1, 5, 8}},
-
-        empty0(0), empty1(1), empty5(5),
-        M1_1(1, {{0}}),
-        M5_2(5, {{0, 1}, {2, 3, 4}}),
-        M5_3(5, {{0, 1}, {2, 3, 4}, {1, 2, 4}}),
-        M5_3_Sec2(5, 3, {{0, 1}, {2}, {2, 3, 4}, {1, 2, 4}}),
-        M6_10(6, { {0, 2}, {0, 1}, {1, 4}, {3}, {3, 4}, {5},
-                   {1}, {0, 1, 2}, {2, 3, 4}, {1, 4, 5} }),
-        MA2AB(10, 9, VA2AB), MA2AB_8(10, 8, VA2AB),
-
-        TestSample({empty0, empty1, empty5, M1_1, M5_2, M5_3, M5_3_Sec2, M6_10,
-                    MA2AB, MA2AB_8}) {}
+  DLXMatrixFixture() :
+      empty0(0), empty1(1), empty5(5),
+      M1_1(1, {{0}}),
+      M5_2(5, {{0, 1}, {2, 3, 4}}),
+      M5_3(5, {{0, 1}, {2, 3, 4}, {1, 2, 4}}),
+      M5_3_Sec2(5, 3, {{0, 1}, {2}, {2, 3, 4}, {1, 2, 4}}),
+      M6_10(6, V6_10),
+      MA2AB(10, 9, VA2AB), MA2AB_8(10, 8, VA2AB),
+      MColor(4, 2) {
+    // Item 2 is colored
+    MColor.add_row_sparse({0, 2, 3}, {0, 1, 0});
+    MColor.add_row_sparse({0, 2}, {0, 2});
+    MColor.add_row_sparse({1, 2}, {0, 1});
+    MColor.add_row_sparse({1, 2}, {0, 2});
+    MColor.add_row_sparse({0});
+    MColor.add_row_sparse({1, 3});
+    MColor.add_row_sparse({0, 1});
+  }
   // clang-format on
  protected:
-  DLXMatrix::Vect2D VA2AB;
   DLXMatrix empty0, empty1, empty5, M1_1, M5_2, M5_3, M5_3_Sec2, M6_10, MA2AB,
-      MA2AB_8;
+      MA2AB_8, MColor;
   const std::string M5_3_Sec2_str =
       "[1, 1, 0 | 0, 0]\n"
       "[0, 0, 1 | 0, 0]\n"
       "[0, 0, 1 | 1, 1]\n"
       "[0, 1, 1 | 0, 1]\n";
-  std::vector<DLXMatrix> TestSample;
 };
 
 std::string DLXMatrix::to_string() const {
@@ -127,18 +163,36 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix::operator<<") {
   CHECK(os.str() == M5_3_Sec2_str);
 }
 
+uint64_t DLXMatrix::new_generation() {
+  static std::atomic<uint64_t> next(0);
+  return ++next;
+}
+
 DLXMatrix::DLXMatrix(ind_t nb_col, ind_t nb_primary)
     : nb_primary_(std::min(nb_col, nb_primary)),
       depth_(0),
       heads_(nb_col + 1),
+      nb_nodes_(0),
+      free_(nullptr),
+      nb_free_(0),
+      generation_(new_generation()),
       search_down_(true),
+      nb_active_cols_(nb_col),
+      kernel_threshold_(0),
+      kernel_cols_(nb_col),
+      colored_(false),
+      multiplicities_(false),
+      bounds_(nb_col + 1, 1),
+      slacks_(nb_col + 1, 0),
+      buckets_(false),
+      bucket_min_(0),
       nb_choices(0),
       nb_dances(0) {
   for (ind_t i = 0; i <= nb_col; i++) {
     heads_[i].size = 0;
     heads_[i].node.up = heads_[i].node.down = &heads_[i].node;
-    // heads_[i].node.head = &heads_[i];  // unused
-    // heads_[i].node.row_id = -1  // unused;
+    heads_[i].node.head = &heads_[i];
+    heads_[i].node.row_id = header_row;  // tells header nodes from rows
     // heads_[i].node.left = heads_[i].node.right = nullptr;  // unused
   }
   heads_[nb_col].right = &heads_[0];
@@ -167,10 +221,17 @@ TEST_CASE("Constructor DLXMatrix(ind_t, ind_t)") {
   CHECK(M56.nb_primary() == 5);
 }
 
-DLXMatrix::DLXMatrix(ind_t nb_col, ind_t nb_primary, const Vect2D &rows)
-    : DLXMatrix(nb_col, nb_primary) {
-  for (const auto &r : rows) add_row_sparse(r);
+static DLXMatrix build_matrix(ind_t nb_col, ind_t nb_primary,
+                              const Vect2D &rows) {
+  DLXMatrixBuilder builder(nb_col, nb_primary);
+  size_t nb_entries = 0;
+  for (const auto &r : rows) nb_entries += r.size();
+  builder.reserve(rows.size(), nb_entries);
+  for (const auto &r : rows) builder.add_row(r);
+  return builder.finalize();
 }
+DLXMatrix::DLXMatrix(ind_t nb_col, ind_t nb_primary, const Vect2D &rows)
+    : DLXMatrix(build_matrix(nb_col, nb_primary, rows)) {}
 TEST_CASE_FIXTURE(DLXMatrixFixture,
                   "Constructor DLXMatrix(ind_t, const Vect2D &))") {
   CHECK(M5_2.nb_cols() == 5);
@@ -184,18 +245,67 @@ TEST_CASE("Constructor DLXMatrix(ind_t, ind_t, const Vect2D &))") {
   CHECK_NOTHROW(DLXMatrix(3, 2, {{0}, {1, 2}}));
 }
 
+// The links are copied in bulk in a single block and relocated, there is no
+// need to replay the choices.
 DLXMatrix::DLXMatrix(const DLXMatrix &other)
-    : DLXMatrix(other.nb_cols(), other.nb_primary_) {
-  for (const auto &row : other.rows_) add_row_sparse(other.row_sparse(row));
-  for (const Node *nother : other.work_) {
-    ind_t id = other.get_row_id(nother);
-    Node *node = &rows_[id][std::distance(other.rows_[id].data(), nother)];
-    cover(node->head);
-    choose(node);
-  }
-  search_down_ = other.search_down_;
-  nb_choices = other.nb_choices;
-  nb_dances = other.nb_dances;
+    : nb_primary_(other.nb_primary_),
+      depth_(other.depth_),
+      heads_(other.heads_),
+      nb_nodes_(0),
+      free_(nullptr),
+      nb_free_(0),
+      generation_(new_generation()),
+      work_(other.work_),
+      search_down_(other.search_down_),
+      nb_active_cols_(other.nb_active_cols_),
+      kernel_threshold_(other.kernel_threshold_),
+      kernel_cols_(other.kernel_cols_),
+      colored_(other.colored_),
+      colors_(other.colors_),
+      col_colors_(other.col_colors_),
+      color_start_(other.color_start_),
+      multiplicities_(other.multiplicities_),
+      bounds_(other.bounds_),
+      slacks_(other.slacks_),
+      buckets_(other.buckets_),
+      bucket_next_(other.bucket_next_),
+      bucket_prev_(other.bucket_prev_),
+      bucket_min_(other.bucket_min_),
+      symmetries_(other.symmetries_),
+      nb_choices(other.nb_choices),
+      nb_dances(other.nb_dances) {
+  Node *nodes = new_nodes(other.nb_nodes_);
+  rows_.reserve(other.rows_.size());
+  for (const Row &row : other.rows_) {
+    rows_.emplace_back(nodes, row.size());
+    nodes = std::copy(row.begin(), row.end(), nodes);
+  }
+  const Header *oheads = other.heads_.data();
+  auto head = [this, oheads](const Header *h) {
+    return heads_.data() + (h - oheads);
+  };
+  // Reads the row id in other, which is still alive
+  auto node = [this, &other, &head](const Node *n) {
+    if (n->row_id == header_row) return &head(n->head)->node;
+    return rows_[n->row_id].data() + (n - other.rows_[n->row_id].data());
+  };
+  for (Header &h : heads_) {
+    h.left = head(h.left);
+    h.right = head(h.right);
+    h.node.up = node(h.node.up);
+    h.node.down = node(h.node.down);
+    h.node.head = &h;
+  }
+  for (const Row &row : rows_) {
+    for (Node &n : row) {
+      n.left = node(n.left);
+      n.right = node(n.right);
+      n.up = node(n.up);
+      n.down = node(n.down);
+      n.head = head(n.head);
+    }
+  }
+  for (Node *&n : work_) n = node(n);
 }
 TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix copy constructor") {
   for (const DLXMatrix &M : TestSample) {
@@ -212,6 +322,26 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix copy constructor") {
     }
   }
 }
+TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix copy during a search") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(MColor);
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    if (M.nb_rows() > 0) M.choose(ind_t(0));
+    M.search_iter();
+    DLXMatrix N(M);
+    CHECK(N.depth() == M.depth());
+    CHECK(N.nb_choices == M.nb_choices);
+    Vect2D solM, solN;
+    while (M.search_iter()) solM.push_back(M.get_solution());
+    while (N.search_iter()) solN.push_back(N.get_solution());
+    CHECK(solN == solM);
+    // The copy doesn't share any link with the original
+    M.reset();
+    N.reset();
+    CHECK(N.search_rec() == M.search_rec());
+  }
+}
 TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix move constructor/assignement") {
   DLXMatrix M = std::move(M5_3);
   CHECK(M.nb_cols() == 5);
@@ -227,10 +357,31 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix move constructor/assignement") {
 DLXMatrix &DLXMatrix::operator=(const DLXMatrix &other) {
   DLXMatrix res(other);
   nb_primary_ = res.nb_primary_;
+  depth_ = res.depth_;
   heads_ = std::move(res.heads_);
   rows_ = std::move(res.rows_);
+  blocks_ = std::move(res.blocks_);
+  nb_nodes_ = res.nb_nodes_;
+  free_ = res.free_;
+  nb_free_ = res.nb_free_;
+  generation_ = res.generation_;
   work_ = std::move(res.work_);
   search_down_ = res.search_down_;
+  nb_active_cols_ = res.nb_active_cols_;
+  kernel_threshold_ = res.kernel_threshold_;
+  kernel_cols_ = std::move(res.kernel_cols_);
+  colored_ = res.colored_;
+  colors_ = std::move(res.colors_);
+  col_colors_ = std::move(res.col_colors_);
+  color_start_ = std::move(res.color_start_);
+  multiplicities_ = res.multiplicities_;
+  bounds_ = std::move(res.bounds_);
+  slacks_ = std::move(res.slacks_);
+  buckets_ = res.buckets_;
+  bucket_next_ = std::move(res.bucket_next_);
+  bucket_prev_ = std::move(res.bucket_prev_);
+  bucket_min_ = res.bucket_min_;
+  symmetries_ = std::move(res.symmetries_);
   nb_choices = res.nb_choices;
   nb_dances = res.nb_dances;
   return *this;
@@ -247,9 +398,11 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXMatrix::operator=") {
   }
 }
 
-Vect1D DLXMatrix::row_sparse(const std::vector<Node> &row) const {
-  return details::vector_transform(
-      row, [this](const Node &n) -> ind_t { return get_col_id(n.head); });
+Vect1D DLXMatrix::row_sparse(const Row &row) const {
+  Vect1D res;
+  res.reserve(row.size());
+  for (const Node &n : row) res.push_back(get_col_id(n.head));
+  return res;
 }
 Vect1D DLXMatrix::ith_row_sparse(ind_t i) const {
   return row_sparse(rows_[i]);
@@ -261,7 +414,25 @@ TEST_CASE("Method ith_row_sparse") {
   CHECK(M.ith_row_sparse(2) == Vect1D({1, 2, 4}));
 }
 
-std::vector<bool> DLXMatrix::row_dense(const std::vector<Node> &row) const {
+Vect1D DLXMatrix::row_colors(const Row &row) const {
+  Vect1D res;
+  res.reserve(row.size());
+  for (const Node &n : row) res.push_back(get_color(&n));
+  return res;
+}
+Vect1D DLXMatrix::ith_row_colors(ind_t i) const {
+  return row_colors(rows_[i]);
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method ith_row_colors") {
+  CHECK(M5_3_Sec2.ith_row_colors(2) == Vect1D({0, 0, 0}));
+  CHECK(MColor.ith_row_colors(0) == Vect1D({0, 1, 0}));
+  CHECK(MColor.ith_row_colors(3) == Vect1D({0, 2}));
+  MColor.choose(ind_t(0));
+  CHECK(MColor.ith_row_colors(0) == Vect1D({0, 1, 0}));
+  CHECK(MColor.ith_row_colors(2) == Vect1D({0, 1}));
+}
+
+std::vector<bool> DLXMatrix::row_dense(const Row &row) const {
   return row_to_dense(DLXMatrix::row_sparse(row));
 }
 std::vector<bool> DLXMatrix::ith_row_dense(ind_t i) const {
@@ -289,15 +460,64 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method check_sizes") {
   }
 }
 
+// The blocks grow with the matrix so that there are few of them, and at
+// most half of the nodes are wasted.
+DLXMatrix::Node *DLXMatrix::new_nodes(size_t nb) {
+  if (nb > nb_free_) {
+    nb_free_ = std::max({nb, nb_nodes_, size_t(64)});
+    blocks_.emplace_back(new Node[nb_free_]);
+    free_ = blocks_.back().get();
+  }
+  Node *res = free_;
+  free_ += nb;
+  nb_free_ -= nb;
+  nb_nodes_ += nb;
+  return res;
+}
+
 ind_t DLXMatrix::add_row_sparse(const Vect1D &r) {
+  return add_row_internal(r, nullptr);
+}
+ind_t DLXMatrix::add_row_sparse(const Vect1D &r, const Vect1D &colors) {
+  if (colors.size() != r.size())
+    throw std::runtime_error("DLXMatrix : colors size mismatch");
+  return add_row_internal(r, colors.data());
+}
+// colors is either nullptr or of the size of r
+ind_t DLXMatrix::add_row_internal(const Vect1D &r, const ind_t *colors) {
   // Assume that the row is not empty and correct
   // if (r.empty()) throw empty_error("rows");
   // Check for bound before modifying anything
   // for (ind_t i : r) heads_.at(i + 1);
+  bool colored = false;
+  for (size_t i = 0; colors && i < r.size(); i++) {
+    if (colors[i] == 0) continue;
+    if (r[i] < nb_primary_)
+      throw std::runtime_error("DLXMatrix : colored primary item");
+    if (colors[i] == purified)
+      throw std::out_of_range("DLXMatrix : color out of range");
+    colored = true;
+  }
+  if (colored && !colored_) {
+    // The rows added so far have no color
+    col_colors_.assign(heads_.size(), 0);
+    for (const Row &row : rows_) {
+      color_start_.push_back(colors_.size());
+      colors_.resize(colors_.size() + row.size(), 0);
+    }
+    colored_ = true;
+    kernel_threshold_ = 0;
+  }
+  if (colored_) {
+    color_start_.push_back(colors_.size());
+    for (size_t i = 0; i < r.size(); i++)
+      colors_.push_back(colors ? colors[i] : 0);
+  }
 
   ind_t row_id = rows_.size();
-  rows_.emplace_back(r.size());
-  std::vector<Node> &row = rows_.back();
+  rows_.emplace_back(new_nodes(r.size()), r.size());
+  const Row &row = rows_.back();
+  generation_ = new_generation();
 
   for (size_t i = 0; i < r.size(); i++) {
     auto &h = heads_[r[i] + 1];
@@ -312,6 +532,19 @@ ind_t DLXMatrix::add_row_sparse(const Vect1D &r) {
   for (size_t i = 0; i < r.size() - 1; i++) row[i].right = &row[i + 1];
   row[0].left = &row.back();
   for (size_t i = 1; i < r.size(); i++) row[i].left = &row[i - 1];
+
+  if (buckets_) {
+    if (work_.empty()) {
+      // All the columns are active, the sizes grew by one
+      ind_t head = bucket_next_.size();
+      bucket_next_.push_back(head);
+      bucket_prev_.push_back(head);
+      for (ind_t i : r)
+        if (i < nb_primary_) bucket_update(&heads_[i + 1]);
+    } else {
+      build_buckets();
+    }
+  }
   return row_id;
 }
 TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_row_sparse") {
@@ -332,6 +565,31 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_row_sparse") {
     }
   }
 }
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_row_sparse with colors") {
+  CHECK_FALSE(M5_3_Sec2.has_colors());
+  CHECK(M5_3_Sec2.add_row_sparse({0, 3}, {0, 0}) == 4);
+  CHECK_FALSE(M5_3_Sec2.has_colors());
+  CHECK_THROWS_WITH_AS(M5_3_Sec2.add_row_sparse({0, 3}, {0}),
+                       "DLXMatrix : colors size mismatch", std::runtime_error);
+  CHECK_THROWS_WITH_AS(M5_3_Sec2.add_row_sparse({0, 3}, {1, 0}),
+                       "DLXMatrix : colored primary item", std::runtime_error);
+  CHECK(M5_3_Sec2.nb_rows() == 5);
+  M5_3_Sec2.set_kernel_threshold(10);
+  // The whole row is checked before the matrix is marked as colored
+  CHECK_THROWS_WITH_AS(M5_3_Sec2.add_row_sparse({4, 0}, {2, 1}),
+                       "DLXMatrix : colored primary item", std::runtime_error);
+  CHECK_FALSE(M5_3_Sec2.has_colors());
+  CHECK(M5_3_Sec2.kernel_threshold() == 10);
+  CHECK(M5_3_Sec2.add_row_sparse({1, 4}, {0, 3}) == 5);
+  CHECK(M5_3_Sec2.has_colors());
+  CHECK(M5_3_Sec2.ith_row_sparse(5) == Vect1D({1, 4}));
+  CHECK(M5_3_Sec2.ith_row_colors(5) == Vect1D({0, 3}));
+  CHECK(M5_3_Sec2.ith_row_colors(4) == Vect1D({0, 0}));
+  CHECK(M5_3_Sec2.kernel_threshold() == 0);
+  M5_3_Sec2.set_kernel_threshold(10);
+  CHECK(M5_3_Sec2.kernel_threshold() == 0);
+  CHECK_NOTHROW(M5_3_Sec2.check_sizes());
+}
 TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_row") {
   CHECK(M5_3.add_row({2, 3}) == 3);
   CHECK(M5_3.ith_row_sparse(3) == Vect1D({2, 3}));
@@ -378,15 +636,21 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_row_dense") {
 }
 
 bool DLXMatrix::is_solution(const Vect1D &sol) const {
-  Vect1D cols(nb_cols());
+  Vect1D cols(nb_cols()), colors(nb_cols());
   for (ind_t r : sol) {
-    std::transform(cols.begin(), cols.end(), ith_row_dense(r).begin(),
-                   cols.begin(), std::plus<>());
+    for (const Node &n : rows_.at(r)) {
+      ind_t col = get_col_id(n.head), color = get_color(&n);
+      // Colored items may be shared by rows of the same color
+      if (cols[col]++ == 0)
+        colors[col] = color;
+      else if (col >= nb_primary_ && (color == 0 || color != colors[col]))
+        return false;
+    }
+  }
+  for (ind_t i = 0; i < nb_primary_; i++) {
+    auto [lo, hi] = multiplicity(i);
+    if (cols[i] < lo || cols[i] > hi) return false;
   }
-  for (ind_t i = 0; i < nb_primary_; i++)
-    if (cols[i] != 1) return false;
-  for (ind_t i = nb_primary_; i < nb_cols(); i++)
-    if (cols[i] > 1) return false;
   return true;
 }
 TEST_CASE_FIXTURE(DLXMatrixFixture, "Method is_solution") {
@@ -422,6 +686,14 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method is_solution") {
     CHECK_FALSE(M5_3_Sec2.is_solution({0}));
     CHECK_FALSE(M5_3_Sec2.is_solution({0, 3}));
   }
+  SUBCASE("MColor (colored secondary columns)") {
+    CHECK(MColor.is_solution({0, 2}));
+    CHECK(MColor.is_solution({1, 3}));
+    CHECK(MColor.is_solution({2, 4}));
+    CHECK_FALSE(MColor.is_solution({0, 3}));
+    CHECK_FALSE(MColor.is_solution({0, 5}));
+    CHECK_FALSE(MColor.is_solution({4, 6}));
+  }
   SUBCASE("MA2AB (1 secondary columns") {
     CHECK(MA2AB.is_solution({0, 8, 9, 10}));
     CHECK(MA2AB.is_solution({8, 9, 0, 10}));
@@ -432,10 +704,71 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method is_solution") {
   }
 }
 
+void DLXMatrix::set_multiplicity(ind_t i, ind_t lo, ind_t hi) {
+  if (i >= nb_primary_)
+    throw std::out_of_range("DLXMatrix : multiplicity of a non primary item");
+  if (lo > hi || hi == 0)
+    throw std::runtime_error("DLXMatrix : bad multiplicity");
+  if (!work_.empty())
+    throw std::runtime_error("DLXMatrix : multiplicity set after a choice");
+  bounds_[i + 1] = hi;
+  slacks_[i + 1] = hi - lo;
+  if (lo != 1 || hi != 1) {
+    multiplicities_ = true;
+    kernel_threshold_ = 0;
+    buckets_ = false;
+  }
+}
+std::pair<ind_t, ind_t> DLXMatrix::multiplicity(ind_t i) const {
+  if (i >= nb_primary_) return {0, 1};
+  return {bounds_[i + 1] - slacks_[i + 1], bounds_[i + 1]};
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method set_multiplicity") {
+  CHECK_FALSE(M6_10.has_multiplicities());
+  CHECK(M6_10.multiplicity(2) == std::make_pair<ind_t, ind_t>(1, 1));
+  M6_10.set_multiplicity(2, 1, 1);
+  CHECK_FALSE(M6_10.has_multiplicities());
+  M6_10.set_multiplicity(2, 0, 3);
+  CHECK(M6_10.has_multiplicities());
+  CHECK(M6_10.multiplicity(2) == std::make_pair<ind_t, ind_t>(0, 3));
+  CHECK(M6_10.kernel_threshold() == 0);
+  CHECK_THROWS_WITH_AS(M6_10.set_multiplicity(6, 0, 3),
+                       "DLXMatrix : multiplicity of a non primary item",
+                       std::out_of_range);
+  CHECK_THROWS_WITH_AS(MA2AB.set_multiplicity(9, 0, 3),
+                       "DLXMatrix : multiplicity of a non primary item",
+                       std::out_of_range);
+  CHECK_THROWS_WITH_AS(M6_10.set_multiplicity(1, 2, 1),
+                       "DLXMatrix : bad multiplicity", std::runtime_error);
+  CHECK_THROWS_WITH_AS(M6_10.set_multiplicity(1, 0, 0),
+                       "DLXMatrix : bad multiplicity", std::runtime_error);
+  DLXMatrix N(M6_10);
+  CHECK(N.multiplicity(2) == std::make_pair<ind_t, ind_t>(0, 3));
+  CHECK(N.has_multiplicities());
+  M5_3.choose(1);
+  CHECK_THROWS_WITH_AS(M5_3.set_multiplicity(1, 0, 3),
+                       "DLXMatrix : multiplicity set after a choice",
+                       std::runtime_error);
+  CHECK_THROWS_WITH_AS(N.search_iter(),
+                       "DLXMatrix : search_iter doesn't support multiplicities",
+                       std::runtime_error);
+  CHECK_THROWS_WITH_AS(N.choose(1),
+                       "DLXMatrix : choose doesn't support multiplicities",
+                       std::runtime_error);
+  CHECK_THROWS_WITH_AS(N.search_step(10),
+                       "DLXMatrix : search_step doesn't support multiplicities",
+                       std::runtime_error);
+  DLXMatrix::count_t count = 0;
+  CHECK_THROWS_WITH_AS(N.count_step({}, count),
+                       "DLXMatrix : count_step doesn't support multiplicities",
+                       std::runtime_error);
+}
+
+// The links of a removed node are left untouched and the removals are undone
+// in reverse order, so its left neighbor never links back to it until it is
+// restored.
 bool DLXMatrix::is_active(const Header *h) const {
-  for (Header *c = master()->right; c != master(); c = c->right)
-    if (c == h) return true;
-  return false;
+  return h->left->right == h;
 }
 static void check_col_active(const DLXMatrix &M, const std::vector<int> &Sol) {
   REQUIRE(M.nb_cols() == Sol.size());
@@ -455,11 +788,7 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method is_col_active") {
 }
 
 bool DLXMatrix::is_active(const Node *nd) const {
-  Header *h = nd->head;
-  if (!is_active(h)) return false;
-  for (Node *row = h->node.down; row != &h->node; row = row->down)
-    if (nd == row) return true;
-  return false;
+  return is_active(nd->head) && nd->up->down == nd;
 }
 static void check_row_active(const DLXMatrix &M, const std::vector<int> &Sol) {
   REQUIRE(M.nb_rows() == Sol.size());
@@ -477,49 +806,83 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method is_row_active") {
   M6_10.choose(5);
   check_row_active(M6_10, {1, 0, 0, 1, 0, 0, 0, 0, 0, 0});
 }
-
-inline void DLXMatrix::hide(Node *row) {
-  for (Node *nr = row->right; nr != row; nr = nr->right) {
-    nr->up->down = nr->down;
-    nr->down->up = nr->up;
-    nr->head->size--;
-    nb_dances++;
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Methods is_row_active and is_col_active "
+                                    "during a search") {
+  // At a solution, the active columns are the ones of no chosen row
+  for (DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    while (M.search_iter()) {
+      std::vector<bool> used(M.nb_cols());
+      for (ind_t r : M.get_solution())
+        for (ind_t c : M.ith_row_sparse(r)) used[c] = true;
+      for (ind_t c = 0; c < M.nb_cols(); c++)
+        CHECK(M.is_col_active(c) == !used[c]);
+      for (ind_t r = 0; r < M.nb_rows(); r++) {
+        bool free = true;
+        for (ind_t c : M.ith_row_sparse(r)) free = free && !used[c];
+        CHECK(M.is_row_active(r) == free);
+      }
+    }
+    for (ind_t c = 0; c < M.nb_cols(); c++) CHECK(M.is_col_active(c));
+    for (ind_t r = 0; r < M.nb_rows(); r++) CHECK(M.is_row_active(r));
   }
 }
-inline void DLXMatrix::cover(Header *col) {
-  col->left->right = col->right;
-  col->right->left = col->left;
-  for (Node *row = col->node.down; row != &col->node; row = row->down) {
-    hide(row);
+
+// Knuth's tweak: a row chosen for an item which remains active is removed
+// from the matrix, so that the later choices for this item only use the
+// following rows.
+inline void DLXMatrix::tweak(Node *nd) {
+  hide(nd);
+  nd->up->down = nd->down;
+  nd->down->up = nd->up;
+  nd->head->size--;
+}
+// Put back the rows tweaked from first (included) up to stop (excluded).
+inline void DLXMatrix::untweak(Header *col, Node *first, Node *stop) {
+  if (first == stop) return;
+  // The tweaked rows are still chained by their down links: relink them in
+  // the column, then unhide them in reverse order.
+  Node *prev = &col->node;
+  for (Node *nd = first; nd != stop; nd = nd->down) {
+    nd->up = prev;
+    prev = nd;
+    col->size++;
   }
+  col->node.down = first;
+  stop->up = prev;
+  for (Node *nd = prev; nd != &col->node; nd = nd->up) unhide(nd);
 }
-inline void DLXMatrix::choose(Node *nd) {
+inline void DLXMatrix::choose_mcc(Node *nd) {
   nb_choices++;
   work_.push_back(nd);
-  for (Node *nr = nd->right; nr != nd; nr = nr->right) cover(nr->head);
-}
-
-inline void DLXMatrix::unhide(Node *row) {
-  for (Node *nr = row->left; nr != row; nr = nr->left) {
-    nr->head->size++;
-    nr->up->down = nr;
-    nr->down->up = nr;
+  for (Node *nr = nd->right; nr != nd; nr = nr->right) {
+    Header *col = nr->head;
+    if (is_primary(col)) {
+      if (--bound(col) == 0) cover(col);
+    } else {
+      commit(nr);
+    }
   }
 }
-inline void DLXMatrix::uncover(Header *col) {
-  col->left->right = col;
-  col->right->left = col;
-
-  for (Node *row = col->node.up; row != &col->node; row = row->up) {
-    unhide(row);
+inline void DLXMatrix::unchoose_mcc(Node *nd) {
+  for (Node *nr = nd->left; nr != nd; nr = nr->left) {
+    Header *col = nr->head;
+    if (is_primary(col)) {
+      if (bound(col)++ == 0) uncover(col);
+    } else {
+      uncommit(nr);
+    }
   }
-}
-inline void DLXMatrix::unchoose(Node *nd) {
-  for (Node *nr = nd->left; nr != nd; nr = nr->left) uncover(nr->head);
   work_.pop_back();
 }
 
 DLXMatrix::Header *DLXMatrix::choose_min() {
+  if (buckets_) {
+    // There is an active primary column, so this stops
+    while (bucket_next_[nb_primary_ + bucket_min_] == nb_primary_ + bucket_min_)
+      bucket_min_++;
+    return &heads_[bucket_next_[nb_primary_ + bucket_min_] + 1];
+  }
   Header *choice = master()->right;
   ind_t min_size = choice->size;
   for (Header *h = choice->right; is_primary(h); h = h->right) {
@@ -531,32 +894,265 @@ DLXMatrix::Header *DLXMatrix::choose_min() {
   return choice;
 }
 
+// Bitset kernel for the end of the search
+//
+// When few columns remain, the residual problem is extracted once: the rows
+// meeting each column and the rows conflicting with each row become bitsets
+// on the active rows. The subtree is then explored by updating the set of
+// the active rows and the one of the uncovered columns, with a few word
+// operations per choice instead of dancing. The columns and the rows are
+// numbered in the same order as in the linked structure so that the kernel
+// makes the same choices as the dancing links.
+///////////////////////////////////////////////////////////////////////////
+// As in dlx_bitset_matrix.cpp, the kernel is compiled with and without POPCNT
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DLX_POPCNT_CLONES __attribute__((target_clones("popcnt", "default")))
+#else
+#define DLX_POPCNT_CLONES
+#endif
+
+namespace {
+// Bitset on NBits bits, made of 64 bits words as in dlx_bitset_matrix.cpp
+template <size_t NBits>
+struct KernelMask {
+  static constexpr size_t word_bits = 64, nb_words = NBits / word_bits;
+  std::array<uint64_t, nb_words> words{};
+
+  void set(size_t b) { words[b / word_bits] |= uint64_t(1) << (b % word_bits); }
+  bool none() const {
+    for (uint64_t w : words)
+      if (w != 0) return false;
+    return true;
+  }
+  // The bits of this which are not in other
+  KernelMask minus(const KernelMask &other) const {
+    KernelMask res;
+    for (size_t i = 0; i < nb_words; i++)
+      res.words[i] = words[i] & ~other.words[i];
+    return res;
+  }
+  // Calls fun on the set bits in increasing order
+  template <typename Fun>
+  void for_each(Fun fun) const {
+    for (size_t i = 0; i < nb_words; i++)
+      for (uint64_t w = words[i]; w != 0; w &= w - 1)
+        fun(i * word_bits + __builtin_ctzll(w));
+  }
+};
+static_assert(DLXMatrix::max_kernel_cols % KernelMask<64>::word_bits == 0);
+
+// The sets of rows are nb_words words long and stored one after the other:
+// the one of the column (resp. row, depth) i starts at i * nb_words.
+template <size_t NBits>
+struct BitsetKernel {
+  using Mask = KernelMask<NBits>;
+  static constexpr size_t word_bits = Mask::word_bits;
+
+  size_t nb_words = 0;
+  std::vector<uint64_t> col_rows;   // The rows meeting each column
+  std::vector<uint64_t> conflicts;  // The rows sharing a column with each row
+  std::vector<uint64_t> active;     // The active rows at each depth
+  std::vector<Mask> row_cols;       // The primary columns of each row
+  Vect1D row_ids;
+  Vect1D sol;
+  unsigned long nb_choices = 0, nb_dances = 0;
+
+  void set(std::vector<uint64_t> &sets, size_t i, size_t r) {
+    sets[i * nb_words + r / word_bits] |= uint64_t(1) << (r % word_bits);
+  }
+
+  // Search the rows covering the columns of todo; report returns false to
+  // stop.
+  template <typename Report>
+  DLX_POPCNT_CLONES bool search(size_t depth, const Mask &todo,
+                                Report &report) {
+    if (todo.none()) return report(sol);
+
+    const uint64_t *act = active.data() + depth * nb_words;
+    size_t col = 0, min_size = std::numeric_limits<size_t>::max();
+    todo.for_each([this, act, &col, &min_size](size_t c) {
+      if (min_size == 0) return;
+      const uint64_t *rows = col_rows.data() + c * nb_words;
+      size_t size = 0;
+      for (size_t i = 0; i < nb_words; i++)
+        size += __builtin_popcountll(act[i] & rows[i]);
+      if (size < min_size) {
+        col = c;
+        min_size = size;
+      }
+    });
+    if (min_size == 0) return true;
+
+    const uint64_t *rows = col_rows.data() + col * nb_words;
+    uint64_t *next = active.data() + (depth + 1) * nb_words;
+    for (size_t w = 0; w < nb_words; w++) {
+      for (uint64_t bits = act[w] & rows[w]; bits != 0; bits &= bits - 1) {
+        size_t r = w * word_bits + __builtin_ctzll(bits);
+        const uint64_t *conf = conflicts.data() + r * nb_words;
+        for (size_t i = 0; i < nb_words; i++) {
+          next[i] = act[i] & ~conf[i];
+          nb_dances += __builtin_popcountll(act[i] & conf[i]);
+        }
+        nb_choices++;
+        sol.push_back(row_ids[r]);
+        bool cont = search(depth + 1, todo.minus(row_cols[r]), report);
+        sol.pop_back();
+        if (!cont) return false;
+      }
+    }
+    return true;
+  }
+};
+}  // namespace
+
+template <size_t NBits, typename Report>
+bool DLXMatrix::search_kernel(Report &report) {
+  // The buffers are kept from one call to the next, the kernel being
+  // entered once at each node where the number of columns falls below the
+  // threshold.
+  static thread_local BitsetKernel<NBits> kernel;
+  static thread_local std::vector<Node *> nodes;
+  kernel.row_ids.clear();
+  kernel.nb_choices = kernel.nb_dances = 0;
+  KernelMask<NBits> todo;
+  ind_t nb_kcols = 0, nb_kprimary = 0;
+  for (Header *h = master()->right; h != master(); h = h->right) {
+    if (is_primary(h)) todo.set(nb_kprimary++);
+    kernel_cols_[get_col_id(h)] = nb_kcols++;
+  }
+  // The rows meeting a primary column, in the order of their ids
+  nodes.clear();
+  for (Header *h = master()->right; is_primary(h); h = h->right)
+    for (Node *p = h->node.down; p != &h->node; p = p->down) nodes.push_back(p);
+  std::sort(nodes.begin(), nodes.end(), [](const Node *a, const Node *b) {
+    return a->row_id < b->row_id;
+  });
+  nodes.erase(std::unique(nodes.begin(), nodes.end(),
+                          [](const Node *a, const Node *b) {
+                            return a->row_id == b->row_id;
+                          }),
+              nodes.end());
+
+  const size_t nb_rows = nodes.size();
+  kernel.nb_words = (nb_rows + kernel.word_bits - 1) / kernel.word_bits;
+  kernel.col_rows.assign(nb_kcols * kernel.nb_words, 0);
+  kernel.row_cols.assign(nb_rows, {});
+  for (size_t r = 0; r < nb_rows; r++) {
+    Node *p = nodes[r];
+    do {
+      ind_t kcol = kernel_cols_[get_col_id(p->head)];
+      kernel.set(kernel.col_rows, kcol, r);
+      if (is_primary(p->head)) kernel.row_cols[r].set(kcol);
+      p = p->right;
+    } while (p != nodes[r]);
+    kernel.row_ids.push_back(get_row_id(p));
+  }
+  kernel.conflicts.assign(nb_rows * kernel.nb_words, 0);
+  for (size_t r = 0; r < nb_rows; r++) {
+    uint64_t *conf = kernel.conflicts.data() + r * kernel.nb_words;
+    Node *p = nodes[r];
+    do {
+      size_t kcol = kernel_cols_[get_col_id(p->head)];
+      const uint64_t *rows = kernel.col_rows.data() + kcol * kernel.nb_words;
+      for (size_t i = 0; i < kernel.nb_words; i++) conf[i] |= rows[i];
+      p = p->right;
+    } while (p != nodes[r]);
+  }
+  // Each choice covers at least one primary column
+  kernel.active.assign((nb_kprimary + 1) * kernel.nb_words, 0);
+  for (size_t r = 0; r < nb_rows; r++) kernel.set(kernel.active, 0, r);
+
+  bool res = kernel.search(0, todo, report);
+  nb_choices += kernel.nb_choices;
+  nb_dances += kernel.nb_dances;
+  return res;
+}
+
+// Search with multiplicities (Knuth's Algorithm M)
+//
+// The chosen item i is the one with the least number of branches
+// size + 1 - need where need = bound - slack is the minimum number of rows
+// still to be chosen for i. The branches are the choices of a row, then if
+// need is 0, leaving i with no more rows. Unless its bound drops to 0, i
+// remains active and the rows already tried are tweaked away, so that each
+// set of rows for i is found once.
+//////////////////////////////////////////////////////////////////////////
+void DLXMatrix::check_no_multiplicities(const char *method) const {
+  if (multiplicities_)
+    throw std::runtime_error(std::string("DLXMatrix : ") + method +
+                             " doesn't support multiplicities");
+}
+
+template <typename Report>
+bool DLXMatrix::search_mcc(Report &report) {
+  if (!is_primary(master()->right)) return report();
+
+  Header *choice = master()->right;
+  long min_branches = std::numeric_limits<long>::max();
+  for (Header *h = choice; is_primary(h); h = h->right) {
+    long need = bound(h) > slack(h) ? bound(h) - slack(h) : 0;
+    long branches = long(h->size) + 1 - need;
+    if (branches < min_branches) {
+      choice = h;
+      min_branches = branches;
+    }
+  }
+  if (min_branches <= 0) return true;
+
+  bool need = bound(choice) > slack(choice), cont = true;
+  if (--bound(choice) == 0) {
+    cover(choice);
+    for (Node *row = choice->node.down; cont && row != &choice->node;
+         row = row->down) {
+      choose_mcc(row);
+      cont = search_mcc(report);
+      unchoose_mcc(row);
+    }
+    if (cont && !need) cont = search_mcc(report);
+    uncover(choice);
+  } else {
+    Node *first = choice->node.down, *row = first;
+    while (cont && row != &choice->node) {
+      tweak(row);
+      choose_mcc(row);
+      cont = search_mcc(report);
+      unchoose_mcc(row);
+      row = row->down;
+    }
+    if (cont && !need) {
+      cover(choice);  // No row left for choice
+      cont = search_mcc(report);
+      uncover(choice);
+    }
+    untweak(choice, first, row);
+  }
+  bound(choice)++;
+  return cont;
+}
+
 // Knuth dancing links search algorithm
 // Recusive version
 ///////////////////////////////////////
 Vect2D DLXMatrix::search_rec(size_t max_sol) {
-  Vect2D res{};
-  nb_choices = nb_dances = 0;
-  search_rec_internal(max_sol, res);
-  return res;
+  return search_rec(MinSize(), max_sol);
 }
-void DLXMatrix::search_rec_internal(size_t max_sol, Vect2D &res) {
-  if (!is_primary(master()->right)) {
+void DLXMatrix::search_rec_mcc(size_t max_sol, Vect2D &res) {
+  auto report = [this, max_sol, &res]() {
     res.push_back(get_solution());
-    return;
-  }
-
-  Header *choice = choose_min();
-  if (choice->size == 0) return;
-
-  cover(choice);
-  for (Node *row = choice->node.down; row != &choice->node; row = row->down) {
-    choose(row);
-    search_rec_internal(max_sol, res);
-    unchoose(row);
-    if (res.size() >= max_sol) break;
-  }
-  uncover(choice);
+    return res.size() < max_sol;
+  };
+  if (max_sol > 0) search_mcc(report);
+}
+void DLXMatrix::search_rec_kernel(size_t max_sol, Vect2D &res) {
+  auto report = [this, max_sol, &res](const Vect1D &end) {
+    res.push_back(get_solution());
+    res.back().insert(res.back().end(), end.begin(), end.end());
+    return res.size() < max_sol;
+  };
+  if (nb_active_cols_ <= 64)
+    search_kernel<64>(report);
+  else
+    search_kernel<max_kernel_cols>(report);
 }
 
 DLXMatrix::Vect2D normalize_solutions(DLXMatrix::Vect2D sols) {
@@ -594,15 +1190,491 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_rec") {
   }
 }
 
+// All the solutions made of rows meeting some primary column
+static Vect2D brute_force_solutions(const DLXMatrix &M) {
+  Vect2D res;
+  for (size_t set = 0; set < (size_t(1) << M.nb_rows()); set++) {
+    Vect1D sol;
+    bool primary = true;
+    for (ind_t r = 0; r < M.nb_rows(); r++) {
+      if (!((set >> r) & 1)) continue;
+      Vect1D row = M.ith_row_sparse(r);
+      primary &= *std::min_element(row.begin(), row.end()) < M.nb_primary();
+      sol.push_back(r);
+    }
+    if (primary && M.is_solution(sol)) res.push_back(sol);
+  }
+  return normalize_solutions(res);
+}
+static DLXMatrix random_colored_matrix(std::mt19937 &rng) {
+  std::uniform_int_distribution<ind_t> item(0, 6), color(0, 2), size(1, 4);
+  DLXMatrix M(7, 3);
+  for (ind_t r = 0; r < 12; r++) {
+    Vect1D row, colors;
+    for (ind_t i = size(rng); i > 0; i--) {
+      ind_t it = item(rng);
+      if (std::find(row.begin(), row.end(), it) != row.end()) continue;
+      row.push_back(it);
+      colors.push_back(it < 3 ? 0 : color(rng));
+    }
+    M.add_row_sparse(row, colors);
+  }
+  return M;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_rec with colors") {
+  CHECK(normalize_solutions(MColor.search_rec()) ==
+        Vect2D({{0, 2}, {1, 3}, {1, 5}, {2, 4}, {3, 4}, {4, 5}, {6}}));
+  CHECK(normalize_solutions(MColor.search_rec()) ==
+        brute_force_solutions(MColor));
+  std::mt19937 rng(42);
+  for (int i = 0; i < 50; i++) {
+    DLXMatrix M = random_colored_matrix(rng);
+    CAPTURE(M);
+    Vect2D sols = M.search_rec();
+    CHECK(normalize_solutions(sols) == brute_force_solutions(M));
+    CHECK_NOTHROW(M.check_sizes());
+    Vect2D iter_sols;
+    while (M.search_iter()) iter_sols.push_back(M.get_solution());
+    CHECK(iter_sols == sols);
+    CHECK(M.count_solutions() == sols.size());
+    if (M.nb_rows() > 0 && M.is_row_active(0)) {
+      M.choose(ind_t(0));
+      DLXMatrix N(M);
+      Vect2D sols0 = M.search_rec();
+      CHECK(N.search_rec() == sols0);
+      for (const Vect1D &s : sols0) CHECK(M.is_solution(s));
+      M.reset();
+      CHECK_NOTHROW(M.check_sizes());
+      CHECK(M.search_rec() == sols);
+    }
+  }
+}
+static DLXMatrix random_bounded_matrix(std::mt19937 &rng) {
+  std::uniform_int_distribution<ind_t> item(0, 5), size(1, 3), bound(0, 2);
+  DLXMatrix M(6, 4);
+  for (ind_t i = 0; i < 4; i++) {
+    ind_t lo = bound(rng), hi = std::max<ind_t>(1, lo + bound(rng));
+    M.set_multiplicity(i, lo, hi);
+  }
+  for (ind_t r = 0; r < 13; r++) {
+    Vect1D row{item(rng)};
+    for (ind_t i = size(rng); i > 1; i--) {
+      ind_t it = item(rng);
+      if (std::find(row.begin(), row.end(), it) == row.end()) row.push_back(it);
+    }
+    M.add_row_sparse(row);
+  }
+  return M;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_rec with multiplicities") {
+  SUBCASE("Bounds [1, 1] give back the usual search") {
+    for (DLXMatrix &M : TestSample) {
+      CAPTURE(M);
+      DLXMatrix N(M);
+      Vect2D sols = M.search_rec();
+      REQUIRE_FALSE(N.has_multiplicities());
+      if (N.nb_primary() == 0) continue;
+      N.set_multiplicity(0, 0, 1);
+      N.set_multiplicity(0, 1, 1);
+      REQUIRE(N.has_multiplicities());
+      CHECK(N.search_rec() == sols);
+      CHECK(N.nb_choices == M.nb_choices);
+      CHECK(N.count_solutions() == sols.size());
+    }
+  }
+  SUBCASE("Two to three pieces in a region") {
+    // Region 0 holds 2 or 3 of the pieces 1, 2, 3, 4
+    DLXMatrix M(5, {{0, 1}, {0, 2}, {0, 3}, {0, 4}, {1}, {2}, {3}, {4}});
+    M.set_multiplicity(0, 2, 3);
+    Vect2D sols = M.search_rec();
+    CHECK(sols.size() == 10);  // binomial(4, 2) + binomial(4, 3)
+    CHECK(normalize_solutions(sols) == brute_force_solutions(M));
+    CHECK(M.count_solutions() == 10);
+    CHECK(M.count_up_to(4) == 4);
+    CHECK(M.search_rec(3).size() == 3);
+  }
+  SUBCASE("Random matrices") {
+    std::mt19937 rng(1234);
+    size_t nb_sols = 0;
+    for (int i = 0; i < 100; i++) {
+      DLXMatrix M = random_bounded_matrix(rng);
+      CAPTURE(M);
+      Vect2D sols = M.search_rec();
+      nb_sols += sols.size();
+      CHECK(normalize_solutions(sols) == brute_force_solutions(M));
+      CHECK(M.count_solutions() == sols.size());
+      CHECK_NOTHROW(M.check_sizes());
+      CHECK(M.search_rec() == sols);
+      Vect1D perm{2, 0, 3, 1, 4, 5};
+      CHECK(normalize_solutions(M.permuted_columns(perm).search_rec()) ==
+            normalize_solutions(sols));
+      Vect1D sol;
+      if (!sols.empty()) {
+        REQUIRE(M.search_random(sol));
+        CHECK(M.is_solution(sol));
+      }
+    }
+    CHECK(nb_sols > 100);
+  }
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_rec with a bitset kernel") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(Langford_matrix(7));
+  Sample.push_back(Langford_matrix(8));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    M.nb_choices = 0;
+    Vect2D expected = M.search_rec();
+    unsigned long expected_choices = M.nb_choices;
+    for (size_t threshold : {3, 5, 64, 256, 1000}) {
+      CAPTURE(threshold);
+      DLXMatrix MK(M);
+      MK.set_kernel_threshold(threshold);
+      CHECK(MK.kernel_threshold() == std::min(threshold,
+                                              DLXMatrix::max_kernel_cols));
+      MK.nb_choices = 0;
+      CHECK(MK.search_rec() == expected);
+      CHECK(MK.nb_choices == expected_choices);
+      MK.nb_choices = 0;
+      const size_t nb_first = std::min<size_t>(2, expected.size());
+      CHECK(MK.search_rec(2) ==
+            Vect2D(expected.begin(), expected.begin() + nb_first));
+    }
+  }
+  SUBCASE("Kernel after a choice") {
+    DLXMatrix M = Langford_matrix(8);
+    M.choose(3);
+    Vect2D expected = M.search_rec();
+    M.set_kernel_threshold(DLXMatrix::max_kernel_cols);
+    CHECK(M.search_rec() == expected);
+  }
+}
+
+count_t DLXMatrix::count_solutions() {
+  return count_up_to(MinSize(), std::numeric_limits<count_t>::max());
+}
+count_t DLXMatrix::count_up_to(count_t max_sol) {
+  return count_up_to(MinSize(), max_sol);
+}
+void DLXMatrix::count_mcc(count_t max_sol, count_t &count) {
+  auto report = [max_sol, &count]() { return ++count < max_sol; };
+  search_mcc(report);
+}
+void DLXMatrix::count_kernel(count_t max_sol, count_t &count) {
+  auto report = [max_sol, &count](const Vect1D &) {
+    return ++count < max_sol;
+  };
+  if (nb_active_cols_ <= 64)
+    search_kernel<64>(report);
+  else
+    search_kernel<max_kernel_cols>(report);
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method count_solutions") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(Langford_matrix(7));
+  Sample.push_back(Langford_matrix(8));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D sols = M.search_rec();
+    unsigned long choices = M.nb_choices, dances = M.nb_dances;
+    CHECK(M.count_solutions() == sols.size());
+    CHECK(M.nb_choices == choices);
+    CHECK(M.nb_dances == dances);
+    M.set_kernel_threshold(64);
+    CHECK(M.count_solutions() == sols.size());
+    CHECK(M.nb_choices == choices);
+    M.set_kernel_threshold(0);
+    CHECK(M.count_up_to(0) == 0);
+    for (size_t k : {1, 2, 5}) {
+      CAPTURE(k);
+      CHECK(M.count_up_to(k) == std::min(k, sols.size()));
+      unsigned long kchoices = M.nb_choices;
+      M.search_rec(k);
+      CHECK(M.nb_choices == kchoices);
+    }
+  }
+  CHECK(Langford_matrix(8).count_up_to(2) == 2);
+  M6_10.choose(5);
+  CHECK(M6_10.count_solutions() == 4);
+  CHECK(M6_10.count_solutions() == 4);
+}
+
+
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Column choice heuristics") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(Langford_matrix(7));
+  Sample.push_back(Langford_matrix(8));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D sols = M.search_rec();
+    unsigned long choices = M.nb_choices;
+    CHECK(M.search_rec(DLXMatrix::MinSize()) == sols);
+    CHECK(M.nb_choices == choices);
+    sols = normalize_solutions(sols);
+    CHECK(normalize_solutions(M.search_rec(DLXMatrix::MinSizeEarly())) ==
+          sols);
+    CHECK(normalize_solutions(M.search_rec(DLXMatrix::MinSizeLength())) ==
+          sols);
+    std::vector<bool> sharp(M.nb_cols());
+    for (size_t i = 0; i < sharp.size(); i += 2) sharp[i] = true;
+    CHECK(normalize_solutions(M.search_rec(DLXMatrix::SharpFirst(sharp))) ==
+          sols);
+    CHECK(normalize_solutions(M.search_rec(DLXMatrix::MinSizeRandom(42))) ==
+          sols);
+    CHECK(M.count_solutions(DLXMatrix::MinSizeEarly()) == sols.size());
+    CHECK(M.count_solutions(DLXMatrix::MinSizeLength()) == sols.size());
+    CHECK(M.count_solutions(DLXMatrix::SharpFirst(sharp)) == sols.size());
+    CHECK(M.count_solutions(DLXMatrix::MinSizeRandom(7)) == sols.size());
+    CHECK(M.count_up_to(DLXMatrix::MinSizeEarly(), 1) ==
+          std::min<size_t>(1, sols.size()));
+  }
+}
+// A user defined heuristic: the last active primary column
+struct LastColumn : DLXMatrix::Heuristic {
+  Header *operator()(DLXMatrix &M) const {
+    Header *choice = first(M);
+    while (is_primary(M, choice->right)) choice = choice->right;
+    return choice;
+  }
+};
+TEST_CASE_FIXTURE(DLXMatrixFixture, "User defined heuristic") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(Langford_matrix(7));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D sols = normalize_solutions(M.search_rec());
+    CHECK(normalize_solutions(M.search_rec(LastColumn())) == sols);
+    CHECK(M.count_solutions(LastColumn()) == sols.size());
+    CHECK(M.count_up_to(LastColumn(), 1) == std::min<size_t>(1, sols.size()));
+  }
+  // The columns 1 and 0 have the same size, the last one is chosen
+  DLXMatrix M(2, {{0}, {1}});
+  M.search_rec(LastColumn());
+  CHECK(M.nb_choices == 2);
+  CHECK(M.search_rec(LastColumn()) == Vect2D({{1, 0}}));
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Heuristic SharpFirst") {
+  // Columns 0 and 1 have size 2, column 2 has size 3
+  DLXMatrix M(3, {{0, 2}, {1, 2}, {0}, {1}, {2}});
+  CHECK(M.search_rec(1) == Vect2D({{0, 3}}));
+  CHECK(M.search_rec(DLXMatrix::SharpFirst({false, true}), 1) ==
+        Vect2D({{1, 2}}));
+  CHECK(M.search_rec(DLXMatrix::SharpFirst({false, false, true}), 1) ==
+        Vect2D({{0, 3}}));
+  // An empty column is always chosen
+  DLXMatrix M3(3, {{0}, {1}});
+  CHECK(M3.search_rec(DLXMatrix::SharpFirst({true, true})).empty());
+  CHECK(M3.nb_choices == 0);
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Heuristic MinSizeRandom") {
+  DLXMatrix M = Langford_matrix(7);
+  Vect2D sols = M.search_rec(DLXMatrix::MinSizeRandom(3));
+  CHECK(M.search_rec(DLXMatrix::MinSizeRandom(3)) == sols);
+  bool differ = false;
+  for (unsigned seed = 4; seed < 10 && !differ; seed++)
+    differ = M.search_rec(DLXMatrix::MinSizeRandom(seed)) != sols;
+  CHECK(differ);
+}
+
+void DLXMatrix::set_bucket_queue(bool enable) {
+  buckets_ = enable && !multiplicities_;
+  if (buckets_) {
+    build_buckets();
+  } else {
+    bucket_next_.clear();
+    bucket_prev_.clear();
+  }
+}
+void DLXMatrix::build_buckets() {
+  // A column meets at most all the rows
+  const ind_t nb_entries = nb_primary_ + nb_rows() + 1;
+  bucket_next_.resize(nb_entries);
+  bucket_prev_.resize(nb_entries);
+  for (ind_t i = nb_primary_; i < nb_entries; i++)
+    bucket_next_[i] = bucket_prev_[i] = i;
+  bucket_min_ = nb_rows();
+  // Inserted backward, so that the first choice is the one of the scan
+  for (Header *h = master()->left; h != master(); h = h->left)
+    if (is_primary(h)) bucket_insert(get_col_id(h), h->size);
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method set_bucket_queue") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(Langford_matrix(7));
+  Sample.push_back(Langford_matrix(8));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D sols = normalize_solutions(M.search_rec());
+    CHECK_FALSE(M.bucket_queue());
+    M.set_bucket_queue(true);
+    CHECK(M.bucket_queue());
+    Vect2D res = M.search_rec();
+    CHECK(normalize_solutions(res) == sols);
+    CHECK(M.count_solutions() == sols.size());
+    Vect2D resiter;
+    while (M.search_iter()) resiter.push_back(M.get_solution());
+    CHECK(normalize_solutions(resiter) == sols);
+    CHECK(normalize_solutions(M.search_rec(DLXMatrix::MinSizeEarly())) ==
+          sols);
+    // Copies search in the same order
+    if (M.nb_rows() > 0) M.choose(ind_t(0));
+    DLXMatrix N(M), P(0);
+    P = M;
+    res = M.search_rec();
+    CHECK(N.bucket_queue());
+    CHECK(N.search_rec() == res);
+    CHECK(P.search_rec() == res);
+    M.set_bucket_queue(false);
+    CHECK(normalize_solutions(M.search_rec()) == normalize_solutions(res));
+  }
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Bucket queue and add_row") {
+  DLXMatrix M(4);
+  M.set_bucket_queue(true);
+  M.add_row({0, 1});
+  M.add_row({2, 3});
+  M.add_row({0});
+  M.add_row({1, 2});
+  M.add_row({3});
+  CHECK(normalize_solutions(M.search_rec()) == Vect2D({{0, 1}, {2, 3, 4}}));
+  M.choose(ind_t(4));
+  M.add_row({0, 1});
+  M.add_row({2});
+  CHECK(normalize_solutions(M.search_rec()) ==
+        Vect2D({{0, 4, 6}, {2, 3, 4}, {4, 5, 6}}));
+  M.reset();
+  M.set_multiplicity(0, 1, 2);
+  CHECK_FALSE(M.bucket_queue());
+  M.set_bucket_queue(true);
+  CHECK_FALSE(M.bucket_queue());
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Bucket queue with colors") {
+  Vect2D sols = normalize_solutions(MColor.search_rec());
+  MColor.set_bucket_queue(true);
+  CHECK(normalize_solutions(MColor.search_rec()) == sols);
+}
+
+// Split the search tree below the current choices: returns the lists of rows
+// chosen by the search down to the given depth, in search order. Branches
+// ending with a solution before depth give shorter lists; dead ends are
+// dropped. Any ongoing search is reset.
+Vect2D DLXMatrix::subproblems(size_t depth) {
+  check_no_multiplicities("subproblems");
+  Vect2D res{};
+  Vect1D prefix{};
+  reset(depth_);
+  subproblems_internal(depth, prefix, res);
+  return res;
+}
+void DLXMatrix::subproblems_internal(size_t depth, Vect1D &prefix,
+                                     Vect2D &res) {
+  if (prefix.size() == depth || !is_primary(master()->right)) {
+    res.push_back(prefix);
+    return;
+  }
+  Header *choice = choose_min();
+  if (choice->size == 0) return;
+
+  cover(choice);
+  for (Node *row = choice->node.down; row != &choice->node; row = row->down) {
+    choose(row);
+    prefix.push_back(get_row_id(row));
+    subproblems_internal(depth, prefix, res);
+    prefix.pop_back();
+    unchoose(row);
+  }
+  uncover(choice);
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method subproblems") {
+  CHECK(M6_10.subproblems(0) == Vect2D({{}}));
+  CHECK(M6_10.subproblems(1) == Vect2D({{5}, {9}}));
+  CHECK(M6_10.subproblems(2) == Vect2D({{5, 0}, {5, 1}, {5, 7}, {9, 0}}));
+  CHECK(M6_10.subproblems(10) == M6_10.search_rec());
+  CHECK(M5_3.subproblems(1) == Vect2D({{0}}));
+  CHECK(empty5.subproblems(2) == Vect2D({}));
+  M6_10.choose(5);
+  CHECK(M6_10.subproblems(1) == Vect2D({{0}, {1}, {7}}));
+  CHECK(M6_10.depth() == 1);
+
+  SUBCASE("The subtrees give back the full search") {
+    for (DLXMatrix &M : TestSample) {
+      CAPTURE(M);
+      Vect2D expected = M.search_rec();
+      unsigned long choices = M.nb_choices, dances = M.nb_dances;
+      for (size_t depth : {0, 1, 2, 3}) {
+        CAPTURE(depth);
+        Vect2D subs = M.subproblems(depth), sols;
+        unsigned long sub_choices = M.nb_choices, sub_dances = M.nb_dances;
+        for (const Vect1D &prefix : subs) {
+          for (ind_t r : prefix) M.choose(r);
+          M.reset(M.depth());
+          for (const Vect1D &s : M.search_rec()) sols.push_back(s);
+          sub_choices += M.nb_choices;
+          sub_dances += M.nb_dances;
+          M.reset();
+        }
+        CHECK(sols == expected);
+        CHECK(sub_choices == choices);
+        CHECK(sub_dances == dances);
+      }
+    }
+  }
+}
+
 // Knuth dancing links search algorithm
 // Iterative version
 ///////////////////////////////////////
 bool DLXMatrix::search_iter() {
+  StepStops stops = step_stops(SearchLimits());
+  return search_until(stops, "search_iter") == SearchStatus::solution;
+}
+// Adds without overflow
+static unsigned long add_budget(unsigned long count, unsigned long budget) {
+  return budget > std::numeric_limits<unsigned long>::max() - count
+             ? std::numeric_limits<unsigned long>::max()
+             : count + budget;
+}
+DLXMatrix::StepStops DLXMatrix::step_stops(const SearchLimits &limits) const {
+  using clock = std::chrono::steady_clock;
+  StepStops res{add_budget(nb_choices, limits.max_choices),
+                add_budget(nb_dances, limits.max_dances),
+                std::numeric_limits<unsigned long>::max(),
+                clock::time_point::max(), limits.stop};
+  if (limits.max_time != clock::duration::max()) {
+    clock::time_point now = clock::now();
+    res.deadline = limits.max_time > clock::time_point::max() - now
+                       ? clock::time_point::max()
+                       : now + limits.max_time;
+  }
+  if (res.stop || res.deadline != clock::time_point::max())
+    res.poll = nb_choices;
+  return res;
+}
+SearchStatus DLXMatrix::search_step(unsigned long max_choices) {
+  SearchLimits limits;
+  limits.max_choices = max_choices;
+  StepStops stops = step_stops(limits);
+  return search_until(stops, "search_step");
+}
+SearchStatus DLXMatrix::search_step(const SearchLimits &limits) {
+  StepStops stops = step_stops(limits);
+  return search_until(stops, "search_step");
+}
+SearchStatus DLXMatrix::search_until(StepStops &stops, const char *method) {
+  check_no_multiplicities(method);
   while (search_down_ || work_.size() > depth_) {
     if (search_down_) {  // going down the recursion
       if (!is_primary(master()->right)) {
         search_down_ = false;
-        return true;
+        return SearchStatus::solution;
+      }
+      if (nb_choices >= stops.choices || nb_dances >= stops.dances)
+        return SearchStatus::suspended;
+      if (nb_choices >= stops.poll) {
+        stops.poll = add_budget(nb_choices, poll_interval);
+        if (stops.stop && stops.stop->load(std::memory_order_relaxed))
+          return SearchStatus::cancelled;
+        if (std::chrono::steady_clock::now() >= stops.deadline)
+          return SearchStatus::suspended;
       }
       Header *choice = choose_min();
       if (choice->size == 0) {
@@ -624,7 +1696,15 @@ bool DLXMatrix::search_iter() {
       }
     }
   }
-  return false;
+  return SearchStatus::finished;
+}
+SearchStatus DLXMatrix::count_step(const SearchLimits &limits,
+                                   count_t &count) {
+  StepStops stops = step_stops(limits);
+  SearchStatus st;
+  while ((st = search_until(stops, "count_step")) == SearchStatus::solution)
+    count++;
+  return st;
 }
 bool DLXMatrix::search_iter(Vect1D &v) {
   bool res;
@@ -662,6 +1742,145 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_iter") {
   }
 }
 
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_step") {
+  for (auto M : TestSample) {
+    CAPTURE(M);
+    DLXMatrix MSave(M);
+    Vect2D expected;
+    while (MSave.search_iter()) expected.push_back(MSave.get_solution());
+    for (unsigned long budget : {1, 2, 3, 100}) {
+      CAPTURE(budget);
+      DLXMatrix N(M);
+      Vect2D sols;
+      SearchStatus st;
+      size_t nb_steps = 0;
+      while ((st = N.search_step(budget)) != SearchStatus::finished) {
+        nb_steps++;
+        if (st == SearchStatus::solution) sols.push_back(N.get_solution());
+      }
+      CHECK(sols == expected);
+      CHECK(N.nb_choices == MSave.nb_choices);
+      CHECK(nb_steps >= MSave.nb_choices / budget);
+      CHECK(N.search_step(budget) == SearchStatus::finished);
+    }
+  }
+  CHECK(M6_10.search_step(0) == SearchStatus::suspended);
+  CHECK(M6_10.nb_choices == 0);
+  CHECK(M6_10.search_step(3) == SearchStatus::suspended);
+  CHECK(M6_10.nb_choices == 3);
+  CHECK(M6_10.search_step(1) == SearchStatus::solution);
+  CHECK(M6_10.get_solution() == Vect1D({5, 0, 2, 3}));
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_step with limits") {
+  DLXMatrix M = Langford_matrix(8);
+  DLXMatrix MSave(M);
+  Vect2D expected;
+  while (MSave.search_iter()) expected.push_back(MSave.get_solution());
+  DLXMatrix::SearchLimits limits;
+  SUBCASE("dances") {
+    limits.max_dances = 100;
+    Vect2D sols;
+    SearchStatus st;
+    unsigned long dances = M.nb_dances;
+    while ((st = M.search_step(limits)) != SearchStatus::finished) {
+      if (st == SearchStatus::solution) sols.push_back(M.get_solution());
+      // A step stops at the first choice after the budget is spent
+      CHECK(M.nb_dances - dances < 100 + 4 * M.nb_rows());
+      dances = M.nb_dances;
+    }
+    CHECK(sols == expected);
+    CHECK(M.nb_dances == MSave.nb_dances);
+  }
+  SUBCASE("stop token") {
+    std::atomic<bool> stop(true);
+    limits.stop = &stop;
+    CHECK(M.search_step(limits) == SearchStatus::cancelled);
+    CHECK(M.nb_choices == 0);
+    CHECK(M.search_step(limits) == SearchStatus::cancelled);
+    stop = false;
+    // The token is checked again after poll_interval choices
+    DLXMatrix::count_t count = 0;
+    CHECK(M.count_step(limits, count) == SearchStatus::finished);
+    CHECK(count == expected.size());
+    CHECK(M.nb_choices == MSave.nb_choices);
+  }
+  SUBCASE("time") {
+    limits.max_time = std::chrono::steady_clock::duration::zero();
+    CHECK(M.search_step(limits) == SearchStatus::suspended);
+    CHECK(M.nb_choices == 0);
+    limits.max_time = std::chrono::hours(1);
+    DLXMatrix::count_t count = 0;
+    CHECK(M.count_step(limits, count) == SearchStatus::finished);
+    CHECK(count == expected.size());
+  }
+  SUBCASE("count_step") {
+    limits.max_choices = 500;
+    DLXMatrix::count_t count = 0;
+    size_t nb_steps = 0;
+    while (M.count_step(limits, count) == SearchStatus::suspended) nb_steps++;
+    CHECK(count == expected.size());
+    CHECK(nb_steps == MSave.nb_choices / 500);
+    CHECK(M.nb_choices == MSave.nb_choices);
+  }
+  SUBCASE("DLXSearch") {
+    std::atomic<bool> stop(false);
+    limits.stop = &stop;
+    DLXSearch<DLXMatrix> search(M);
+    CHECK(search.resume(limits) == SearchStatus::solution);
+    stop = true;
+    size_t nb = 1;
+    while (search.resume(limits) == SearchStatus::solution) nb++;
+    CHECK(search.status() == SearchStatus::cancelled);
+    stop = false;
+    while (search.resume(limits) == SearchStatus::solution) nb++;
+    CHECK(search.done());
+    CHECK(nb == expected.size());
+  }
+}
+
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_visit") {
+  SUBCASE("agrees with search_iter") {
+    for (auto M : TestSample) {
+      CAPTURE(M);
+      DLXMatrix MSave(M);
+      Vect2D sols;
+      CHECK(M.search_visit([&sols](DLXMatrix::SolutionView sol) {
+        sols.push_back(sol.to_vector());
+      }) == sols.size());
+      Vect2D expected;
+      while (MSave.search_iter()) expected.push_back(MSave.get_solution());
+      CHECK(sols == expected);
+      CHECK(M.nb_choices == MSave.nb_choices);
+      CHECK(M.nb_dances == MSave.nb_dances);
+    }
+  }
+  SUBCASE("view") {
+    M6_10.search_visit([](const DLXMatrix::SolutionView &sol) {
+      CHECK(sol.size() == 4);
+      CHECK_FALSE(sol.empty());
+      CHECK(sol[0] == 5);
+      CHECK(sol[3] == 3);
+      CHECK(Vect1D(sol.begin(), sol.end()) == Vect1D({5, 0, 2, 3}));
+      return false;
+    });
+    CHECK(M6_10.solution_view().to_vector() == Vect1D({5, 0, 2, 3}));
+    CHECK(M6_10.get_solution() == Vect1D({5, 0, 2, 3}));
+  }
+  SUBCASE("stop and resume") {
+    Vect2D sols;
+    auto visit = [&sols](DLXMatrix::SolutionView sol) {
+      sols.push_back(sol.to_vector());
+      return sols.size() % 2 != 0;
+    };
+    CHECK(M6_10.search_visit(visit) == 2);
+    CHECK(M6_10.search_visit(visit) == 2);
+    CHECK(M6_10.search_visit(visit) == 1);
+    CHECK(M6_10.search_visit(visit) == 0);
+    CHECK(sols == Vect2D({{5, 0, 2, 3}, {5, 0, 6, 4}, {5, 1, 8}, {5, 7, 4},
+                          {9, 0, 3}}));
+  }
+}
+
 Vect1D DLXMatrix::get_solution() {
   return details::vector_transform(
       work_, [this](Node *n) -> ind_t { return get_row_id(n); });
@@ -679,7 +1898,7 @@ void DLXMatrix::reset(size_t depth) {
   while (work_.size() > depth) {
     Node *row = work_.back();
     unchoose(row);
-    uncover(row->head);
+    uncommit(row);
   }
   search_down_ = true;
   depth_ = work_.size();
@@ -695,9 +1914,251 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method reset") {
   CHECK(solN == solM);
 }
 
+DLXMatrix::Snapshot DLXMatrix::snapshot() const {
+  Snapshot res;
+  res.generation_ = generation_;
+  res.heads_ = heads_;
+  res.nodes_.reserve(nb_nodes_);
+  for (const Row &row : rows_)
+    res.nodes_.insert(res.nodes_.end(), row.begin(), row.end());
+  res.colors_ = colors_;
+  res.col_colors_ = col_colors_;
+  res.work_ = work_;
+  res.depth_ = depth_;
+  res.search_down_ = search_down_;
+  res.nb_active_cols_ = nb_active_cols_;
+  res.multiplicities_ = multiplicities_;
+  res.bounds_ = bounds_;
+  res.slacks_ = slacks_;
+  res.buckets_ = buckets_;
+  res.bucket_next_ = bucket_next_;
+  res.bucket_prev_ = bucket_prev_;
+  res.bucket_min_ = bucket_min_;
+  return res;
+}
+void DLXMatrix::restore(const Snapshot &snap) {
+  if (snap.generation_ != generation_ || snap.heads_.size() != heads_.size() ||
+      snap.nodes_.size() != nb_nodes_)
+    throw std::runtime_error("DLXMatrix : snapshot of another matrix");
+  // The pointers remain valid: the nodes never move
+  std::copy(snap.heads_.begin(), snap.heads_.end(), heads_.begin());
+  auto it = snap.nodes_.begin();
+  for (const Row &row : rows_) {
+    std::copy(it, it + row.size(), row.begin());
+    it += row.size();
+  }
+  colors_ = snap.colors_;
+  col_colors_ = snap.col_colors_;
+  work_ = snap.work_;
+  depth_ = snap.depth_;
+  search_down_ = snap.search_down_;
+  nb_active_cols_ = snap.nb_active_cols_;
+  multiplicities_ = snap.multiplicities_;
+  bounds_ = snap.bounds_;
+  slacks_ = snap.slacks_;
+  buckets_ = snap.buckets_;
+  bucket_next_ = snap.bucket_next_;
+  bucket_prev_ = snap.bucket_prev_;
+  bucket_min_ = snap.bucket_min_;
+  nb_choices = nb_dances = 0;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Methods snapshot and restore") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(MColor);
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D all = M.search_rec();
+    DLXMatrix::Snapshot base = M.snapshot();
+    if (M.nb_rows() > 0) M.choose(ind_t(0));
+    M.search_iter();
+    DLXMatrix::Snapshot mid = M.snapshot();
+    Vect2D rest;
+    while (M.search_iter()) rest.push_back(M.get_solution());
+    for (int i = 0; i < 2; i++) {
+      M.restore(mid);
+      Vect2D sols;
+      while (M.search_iter()) sols.push_back(M.get_solution());
+      CHECK(sols == rest);
+    }
+    M.restore(base);
+    CHECK(M.depth() == 0);
+    CHECK(M.nb_choices == 0);
+    CHECK(M.search_rec() == all);
+  }
+  DLXMatrix::Snapshot snap = M6_10.snapshot();
+  CHECK_THROWS_AS(M5_2.restore(snap), std::runtime_error);
+  M6_10.add_row({0, 5});
+  CHECK_THROWS_AS(M6_10.restore(snap), std::runtime_error);
+  // A matrix of the same shape, possibly at the same place as the destroyed
+  // one, refuses its snapshots
+  std::optional<DLXMatrix> opt(std::in_place, 6, V6_10);
+  snap = opt->snapshot();
+  opt.reset();
+  opt.emplace(6, V6_10);
+  CHECK_THROWS_AS(opt->restore(snap), std::runtime_error);
+  CHECK_THROWS_AS(DLXMatrix(M5_2).restore(M5_2.snapshot()), std::runtime_error);
+}
+
+// FNV-1a, which unlike std::hash gives the same value on all the platforms
+uint64_t DLXMatrix::fingerprint() const {
+  uint64_t res = 0xcbf29ce484222325ull;
+  auto mix = [&res](uint64_t v) {
+    for (int i = 0; i < 8; i++, v >>= 8) {
+      res ^= v & 0xff;
+      res *= 0x100000001b3ull;
+    }
+  };
+  for (const Row &row : rows_) {
+    mix(row.size());
+    for (const Node &n : row) {
+      mix(get_col_id(n.head));
+      mix(get_color(&n));
+    }
+  }
+  return res;
+}
+// Format:
+//   dlx-checkpoint 2
+//   <nb_cols> <nb_primary> <nb_rows> <fingerprint>
+//   <depth> <search_down> <nb_choices> <nb_dances>
+//   <nb_chosen> followed by <row id> <index in the row> for each choice
+void DLXMatrix::save_checkpoint(std::ostream &out) const {
+  out << "dlx-checkpoint 2\n"
+      << nb_cols() << ' ' << nb_primary_ << ' ' << nb_rows() << ' '
+      << fingerprint() << '\n'
+      << depth_ << ' ' << search_down_ << ' ' << nb_choices << ' '
+      << nb_dances << '\n'
+      << work_.size();
+  for (const Node *nd : work_)
+    out << ' ' << nd->row_id << ' ' << nd - rows_[nd->row_id].data();
+  out << '\n';
+}
+void DLXMatrix::load_checkpoint(std::istream &in) {
+  check_no_multiplicities("load_checkpoint");
+  std::string magic;
+  int version;
+  size_t cols, primary, nbrows, depth, nb_chosen;
+  uint64_t fp;
+  bool down;
+  unsigned long choices, dances;
+  in >> magic >> version >> cols >> primary >> nbrows >> fp;
+  if (!in || magic != "dlx-checkpoint" || version != 2)
+    throw std::runtime_error("DLXMatrix : bad checkpoint");
+  if (cols != nb_cols() || primary != nb_primary_ || nbrows != nb_rows() ||
+      fp != fingerprint())
+    throw std::runtime_error("DLXMatrix : checkpoint of another matrix");
+  in >> depth >> down >> choices >> dances >> nb_chosen;
+  if (!in || depth > nb_chosen)
+    throw std::runtime_error("DLXMatrix : bad checkpoint");
+  std::vector<std::pair<ind_t, ind_t>> chosen(nb_chosen);
+  for (auto &[row, pos] : chosen) {
+    in >> row >> pos;
+    if (!in || row >= nb_rows() || pos >= rows_[row].size())
+      throw std::runtime_error("DLXMatrix : bad checkpoint");
+  }
+  reset();
+  for (auto [row, pos] : chosen) {
+    Node *nd = &rows_[row][pos];
+    if (!is_active(nd->head) || !is_active(nd)) {
+      reset();
+      throw std::runtime_error("DLXMatrix : inconsistent checkpoint");
+    }
+    commit(nd);
+    choose(nd);
+  }
+  depth_ = depth;
+  search_down_ = down;
+  nb_choices = choices;
+  nb_dances = dances;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture,
+                  "Methods save_checkpoint and load_checkpoint") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.push_back(MColor);
+  Sample.push_back(Langford_matrix(7));
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    if (M.nb_rows() > 1) M.choose(ind_t(1));
+    M.reset(M.depth());
+    Vect2D all;
+    while (M.search_iter()) all.push_back(M.get_solution());
+    unsigned long choices = M.nb_choices;
+    M.reset(M.depth());
+    for (size_t steps : {1, 3, 17}) {
+      CAPTURE(steps);
+      // Stop and go through a checkpoint every few choices
+      Vect2D sols;
+      DLXMatrix N(M);
+      for (;;) {
+        SearchStatus st = N.search_step(steps);
+        if (st == SearchStatus::finished) break;
+        if (st == SearchStatus::solution) sols.push_back(N.get_solution());
+        std::stringstream ckpt;
+        N.save_checkpoint(ckpt);
+        N = M;
+        N.load_checkpoint(ckpt);
+      }
+      CHECK(sols == all);
+      CHECK(N.nb_choices == choices);
+    }
+  }
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Errors in load_checkpoint") {
+  std::stringstream ckpt;
+  M6_10.search_iter();
+  M6_10.save_checkpoint(ckpt);
+  std::string str = ckpt.str();
+  // The first two lines identify the matrix
+  std::string head = str.substr(0, str.find('\n', str.find('\n') + 1) + 1);
+  std::stringstream s1(str);
+  CHECK_THROWS_AS(M5_3.load_checkpoint(s1), std::runtime_error);
+  std::stringstream s2("dlx-checkpoint 1\n6 6 10\n0 0 0 0\n0\n");
+  CHECK_THROWS_AS(M6_10.load_checkpoint(s2), std::runtime_error);
+  std::stringstream s3(head + "0 0 0 0\n1 3 1\n");
+  CHECK_THROWS_AS(M6_10.load_checkpoint(s3), std::runtime_error);
+  // Rows 0 and 1 meet on column 0
+  std::stringstream s4(head + "0 0 0 0\n2 0 0 1 0\n");
+  CHECK_THROWS_WITH_AS(M6_10.load_checkpoint(s4),
+                       "DLXMatrix : inconsistent checkpoint",
+                       std::runtime_error);
+  CHECK(M6_10.depth() == 0);
+  std::stringstream s5(str);
+  M6_10.load_checkpoint(s5);
+  std::stringstream again;
+  M6_10.save_checkpoint(again);
+  CHECK(again.str() == str);
+
+  SUBCASE("Same sizes, other rows") {
+    Vect2D rows;
+    for (ind_t i = 0; i < M6_10.nb_rows(); i++)
+      rows.push_back(M6_10.ith_row_sparse(i));
+    std::swap(rows[0], rows[1]);
+    DLXMatrix N(6, rows);
+    std::stringstream s6(str);
+    CHECK_THROWS_WITH_AS(N.load_checkpoint(s6),
+                         "DLXMatrix : checkpoint of another matrix",
+                         std::runtime_error);
+  }
+  SUBCASE("Same rows, other colors") {
+    std::stringstream s7;
+    MColor.save_checkpoint(s7);
+    DLXMatrix N(4, 2);
+    for (ind_t i = 0; i < MColor.nb_rows(); i++) {
+      Vect1D colors = MColor.ith_row_colors(i);
+      for (ind_t &c : colors)
+        if (c != 0) c = 3 - c;
+      N.add_row_sparse(MColor.ith_row_sparse(i), colors);
+    }
+    CHECK_THROWS_WITH_AS(N.load_checkpoint(s7),
+                         "DLXMatrix : checkpoint of another matrix",
+                         std::runtime_error);
+  }
+}
+
 ind_t DLXMatrix::choose(ind_t i) {
+  check_no_multiplicities("choose");
   Node *nd = rows_[i].data();
-  cover(nd->head);
+  commit(nd);
   choose(nd);
   return ++depth_;
 }
@@ -722,12 +2183,17 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method choose") {
 DLXMatrix DLXMatrix::permuted_inv_columns(const Vect1D &perm) const {
   // No check is performed
   // check_size("permutation", perm.size(), nb_cols());
-  DLXMatrix res(nb_cols());
-  for (const auto &row : rows_) {
-    res.add_row_sparse(details::vector_transform(
-        row, [this, &perm](const Node &n) -> ind_t {
-          return perm[get_col_id(n.head)];
-        }));
+  DLXMatrixBuilder builder(nb_cols(), nb_primary_);
+  builder.reserve(nb_rows(), nb_nodes_);
+  for (const Row &row : rows_) {
+    for (const Node &n : row)
+      builder.add_item(perm[get_col_id(n.head)], get_color(&n));
+    builder.end_row();
+  }
+  DLXMatrix res = builder.finalize();
+  for (ind_t i = 0; i < nb_primary_; i++) {
+    auto [lo, hi] = multiplicity(i);
+    if (perm[i] < nb_primary_) res.set_multiplicity(perm[i], lo, hi);
   }
   return res;
 }
@@ -788,8 +2254,13 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method permuted_columns") {
 DLXMatrix DLXMatrix::permuted_rows(const Vect1D &perm) const {
   // if (perm.size() != nb_rows())
   //    throw size_mismatch_error("permutation", perm.size(), nb_rows());
-  DLXMatrix res(nb_cols());
-  for (ind_t i : perm) res.add_row_sparse(row_sparse(rows_[i]));
+  DLXMatrix res(nb_cols(), nb_primary_);
+  for (ind_t i : perm)
+    res.add_row_sparse(row_sparse(rows_[i]), row_colors(rows_[i]));
+  for (ind_t i = 0; i < nb_primary_; i++) {
+    auto [lo, hi] = multiplicity(i);
+    res.set_multiplicity(i, lo, hi);
+  }
   return res;
 }
 TEST_CASE_FIXTURE(DLXMatrixFixture, "Method permuted_rows") {
@@ -812,6 +2283,224 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method permuted_rows") {
   }
 }
 
+Vect1D DLXMatrix::symmetry_rows(const Vect1D &col_perm) const {
+  if (col_perm.size() != nb_cols())
+    throw std::runtime_error("DLXMatrix : symmetry size mismatch");
+  std::vector<bool> seen(nb_cols());
+  for (ind_t i = 0; i < nb_cols(); i++) {
+    ind_t c = col_perm[i];
+    if (c >= nb_cols() || seen[c] || (i < nb_primary_) != (c < nb_primary_))
+      throw std::runtime_error("DLXMatrix : not a symmetry");
+    seen[c] = true;
+  }
+  // Row r of the image is the image of row r; equal rows are matched in
+  // order.
+  std::map<Vect1D, std::deque<ind_t>> ids;
+  for (ind_t r = 0; r < nb_rows(); r++) {
+    Vect1D row = row_sparse(rows_[r]);
+    std::sort(row.begin(), row.end());
+    ids[row].push_back(r);
+  }
+  DLXMatrix image = permuted_inv_columns(col_perm);
+  Vect1D res(nb_rows());
+  for (ind_t r = 0; r < nb_rows(); r++) {
+    Vect1D row = image.ith_row_sparse(r);
+    std::sort(row.begin(), row.end());
+    auto it = ids.find(row);
+    if (it == ids.end() || it->second.empty())
+      throw std::runtime_error("DLXMatrix : not a symmetry");
+    res[r] = it->second.front();
+    it->second.pop_front();
+  }
+  return res;
+}
+void DLXMatrix::add_symmetry(const Vect1D &col_perm) {
+  if (colored_)
+    throw std::runtime_error("DLXMatrix : symmetries don't support colors");
+  symmetry_rows(col_perm);  // checks col_perm
+  symmetries_.push_back(col_perm);
+}
+std::vector<DLXMatrix::Symmetry> DLXMatrix::symmetry_group() const {
+  // Colored rows may have been added after the symmetries
+  if (colored_ && !symmetries_.empty())
+    throw std::runtime_error("DLXMatrix : symmetries don't support colors");
+  Symmetry id{Vect1D(nb_cols()), Vect1D(nb_rows())};
+  std::iota(id.cols.begin(), id.cols.end(), 0);
+  std::iota(id.rows.begin(), id.rows.end(), 0);
+  std::vector<Symmetry> gens;
+  for (const Vect1D &cols : symmetries_)
+    gens.push_back({cols, symmetry_rows(cols)});
+  // Closure under composition with the generators
+  std::vector<Symmetry> res{id};
+  std::set<Vect1D> known{id.cols};
+  for (size_t i = 0; i < res.size(); i++) {
+    for (const Symmetry &g : gens) {
+      Symmetry gh{Vect1D(nb_cols()), Vect1D(nb_rows())};
+      for (ind_t c = 0; c < nb_cols(); c++) gh.cols[c] = g.cols[res[i].cols[c]];
+      if (!known.insert(gh.cols).second) continue;
+      for (ind_t r = 0; r < nb_rows(); r++) gh.rows[r] = g.rows[res[i].rows[r]];
+      res.push_back(std::move(gh));
+      if (res.size() > max_symmetries)
+        throw std::runtime_error("DLXMatrix : too many symmetries");
+    }
+  }
+  return res;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method add_symmetry") {
+  CHECK(M6_10.nb_symmetries() == 1);
+  CHECK_THROWS_AS(M6_10.add_symmetry({0, 1, 2}), std::runtime_error);
+  CHECK_THROWS_AS(M6_10.add_symmetry({1, 0, 2, 3, 4, 5}), std::runtime_error);
+  CHECK_THROWS_AS(M6_10.add_symmetry({0, 0, 2, 3, 4, 5}), std::runtime_error);
+  CHECK(M6_10.nb_symmetries() == 1);
+  M6_10.add_symmetry({0, 1, 2, 3, 4, 5});
+  CHECK(M6_10.nb_symmetries() == 1);
+  // Primary columns must be mapped to primary ones
+  DLXMatrix M(3, 2, {{0}, {1}, {2}});
+  CHECK_THROWS_AS(M.add_symmetry({0, 2, 1}), std::runtime_error);
+  M.add_symmetry({1, 0, 2});
+  CHECK(M.nb_symmetries() == 2);
+  // The symmetric group on 4 points acting on the pairs
+  DLXMatrix P(4, {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}});
+  P.add_symmetry({1, 0, 2, 3});
+  P.add_symmetry({1, 2, 3, 0});
+  CHECK(P.nb_symmetries() == 24);
+  CHECK_THROWS_AS(MColor.add_symmetry({0, 1, 2, 3}), std::runtime_error);
+  // The colors of the rows added afterwards are not checked by add_symmetry
+  DLXMatrix C(4, 2);
+  C.add_symmetry({0, 1, 3, 2});
+  C.add_row_sparse({0, 2}, {0, 1});
+  C.add_row_sparse({0, 3}, {0, 1});
+  C.add_row_sparse({1, 2}, {0, 1});
+  C.add_row_sparse({1, 3}, {0, 2});
+  CHECK(C.count_solutions() == 3);
+  CHECK_THROWS_AS(C.nb_symmetries(), std::runtime_error);
+  CHECK_THROWS_AS(C.count_solutions_sym(), std::runtime_error);
+  CHECK_THROWS_AS(C.search_orbits(), std::runtime_error);
+}
+
+template <typename Report>
+void DLXMatrix::search_sym(const std::vector<const Symmetry *> &group,
+                           count_t weight, Report &report) {
+  if (!is_primary(master()->right)) {
+    report(weight);
+    return;
+  }
+  // Only the identity is left
+  if (group.size() == 1 && report.plain(weight)) return;
+  Header *choice = choose_min();
+  if (choice->size == 0) return;
+
+  // The symmetries fixing the choices and the column map the subproblems of
+  // the rows of the column onto each other: only one row of each orbit is
+  // explored.
+  ind_t col = get_col_id(choice);
+  std::vector<const Symmetry *> stab;
+  for (const Symmetry *g : group)
+    if (g->cols[col] == col) stab.push_back(g);
+  Vect1D seen;
+  cover(choice);
+  for (Node *row = choice->node.down; row != &choice->node; row = row->down) {
+    ind_t r = row->row_id;
+    if (std::find(seen.begin(), seen.end(), r) != seen.end()) continue;
+    std::vector<const Symmetry *> sub;
+    count_t orbit = 0;
+    for (const Symmetry *g : stab) {
+      ind_t img = g->rows[r];
+      if (img == r) sub.push_back(g);
+      if (std::find(seen.begin(), seen.end(), img) == seen.end()) {
+        seen.push_back(img);
+        orbit++;
+      }
+    }
+    choose(row);
+    search_sym(sub, weight * orbit, report);
+    unchoose(row);
+  }
+  uncover(choice);
+}
+template <typename Report>
+void DLXMatrix::search_sym(Report &report) {
+  std::vector<Symmetry> group = symmetry_group();
+  std::vector<const Symmetry *> fixing;
+  for (const Symmetry &g : group) {
+    bool fix = true;
+    for (const Node *nd : work_) fix = fix && g.rows[nd->row_id] == nd->row_id;
+    if (fix) fixing.push_back(&g);
+  }
+  search_sym(fixing, 1, report);
+}
+// A report of search_sym is called on the weight of each solution. Its
+// method plain may take over the search of a subtree without symmetries.
+count_t DLXMatrix::count_solutions_sym() {
+  check_no_multiplicities("count_solutions_sym");
+  struct Report {
+    DLXMatrix &M;
+    count_t res;
+    void operator()(count_t weight) { res += weight; }
+    bool plain(count_t weight) {
+      MinSize heur;
+      count_t count = 0;
+      M.count_internal(heur, std::numeric_limits<count_t>::max(), count);
+      res += weight * count;
+      return true;
+    }
+  } report{*this, 0};
+  search_sym(report);
+  return report.res;
+}
+std::vector<std::pair<Vect1D, count_t>> DLXMatrix::search_orbits() {
+  check_no_multiplicities("search_orbits");
+  struct Report {
+    DLXMatrix &M;
+    std::vector<std::pair<Vect1D, count_t>> res;
+    void operator()(count_t weight) {
+      res.emplace_back(M.get_solution(), weight);
+    }
+    bool plain(count_t) { return false; }
+  } report{*this, {}};
+  search_sym(report);
+  return report.res;
+}
+// The reversal of the positions of a Langford matrix
+static Vect1D Langford_reversal(ind_t N) {
+  Vect1D res(3 * N);
+  for (ind_t i = 0; i < N; i++) res[i] = i;
+  for (ind_t p = 0; p < 2 * N; p++) res[N + p] = N + 2 * N - 1 - p;
+  return res;
+}
+TEST_CASE_FIXTURE(DLXMatrixFixture, "Method count_solutions_sym") {
+  for (ind_t N : {4, 7, 8}) {
+    CAPTURE(N);
+    DLXMatrix M = Langford_matrix(N);
+    count_t count = M.count_solutions();
+    unsigned long choices = M.nb_choices;
+    CHECK(M.count_solutions_sym() == count);
+    M.add_symmetry(Langford_reversal(N));
+    CHECK(M.nb_symmetries() == 2);
+    M.nb_choices = 0;
+    CHECK(M.count_solutions_sym() == count);
+    CHECK(M.nb_choices < choices);
+    // Each solution differs from its reversal
+    auto orbits = M.search_orbits();
+    CHECK(orbits.size() * 2 == count);
+    for (auto &[sol, weight] : orbits) {
+      CHECK(M.is_solution(sol));
+      CHECK(weight == 2);
+    }
+  }
+  // Pairs of 4 points, the symmetric group acting on them
+  DLXMatrix P(4, {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}});
+  P.add_symmetry({1, 0, 2, 3});
+  P.add_symmetry({1, 2, 3, 0});
+  CHECK(P.count_solutions_sym() == 3);
+  auto orbits = P.search_orbits();
+  REQUIRE(orbits.size() == 1);
+  CHECK(orbits[0].second == 3);
+  // After a choice, only the symmetries fixing it are used
+  P.choose(ind_t(0));
+  CHECK(P.count_solutions_sym() == 1);
+}
+
 bool DLXMatrix::search_random(Vect1D &sol) {
   static std::mt19937 rng{std::random_device {}()};
 
@@ -824,8 +2513,9 @@ bool DLXMatrix::search_random(Vect1D &sol) {
   std::shuffle(col_perm.begin(), col_perm.begin() + nb_primary_, rng);
 
   DLXMatrix M = permuted_inv_columns(col_perm).permuted_rows(row_perm);
-  if (!M.search_iter()) return false;
-  Vect1D v = M.get_solution();
+  Vect2D sols = M.search_rec(1);
+  if (sols.empty()) return false;
+  const Vect1D &v = sols[0];
   sol.resize(v.size());
   for (size_t i = 0; i < v.size(); i++) sol[i] = row_perm[v[i]];
   return true;
@@ -850,6 +2540,189 @@ TEST_CASE_FIXTURE(DLXMatrixFixture, "Method search_random") {
 TEST_SUITE_END();  // "[dlx_matrix]class DLXMatrix";
 ////////////////////////////////////////////////////
 
+/////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_matrix]class DLXMatrixBuilder");
+/////////////////////////////////////////////////////
+
+void DLXMatrixBuilder::reserve(size_t nb_rows, size_t nb_entries) {
+  row_start_.reserve(nb_rows + 1);
+  cols_.reserve(nb_entries);
+}
+
+ind_t DLXMatrixBuilder::add_row(const Vect1D &r) {
+  for (ind_t col : r) add_item(col);
+  return end_row();
+}
+ind_t DLXMatrixBuilder::add_row(const Vect1D &r, const Vect1D &colors) {
+  if (colors.size() != r.size())
+    throw std::runtime_error("DLXMatrixBuilder : colors size mismatch");
+  for (size_t i = 0; i < r.size(); i++) add_item(r[i], colors[i]);
+  return end_row();
+}
+TEST_CASE("Method DLXMatrixBuilder::add_row") {
+  DLXMatrixBuilder B(5, 3);
+  B.reserve(3, 7);
+  CHECK(B.nb_cols() == 5);
+  CHECK(B.nb_primary() == 3);
+  CHECK(B.add_row({0, 1}) == 0);
+  CHECK(B.add_row({2, 3, 4}) == 1);
+  B.add_item(1);
+  B.add_item(4, 2);
+  CHECK(B.end_row() == 2);
+  CHECK(B.nb_rows() == 3);
+  CHECK(B.nb_entries() == 7);
+  CHECK_THROWS_WITH_AS(B.add_row({0, 3}, {0}),
+                       "DLXMatrixBuilder : colors size mismatch",
+                       std::runtime_error);
+}
+
+// The nodes are laid out row after row. The forward pass links each node
+// to the previous one of its column, which is kept in the up link of the
+// header, the backward pass does the same with the down links.
+DLXMatrix DLXMatrixBuilder::finalize() {
+  if (row_start_.back() != cols_.size())
+    throw std::runtime_error("DLXMatrixBuilder : unfinished row");
+  DLXMatrix res =
+      build(nb_col_, nb_primary_, nb_rows(), row_start_.data(), cols_.data(),
+            colors_.empty() ? nullptr : colors_.data());
+  *this = DLXMatrixBuilder(nb_col_, nb_primary_);
+  return res;
+}
+DLXMatrix DLXMatrixBuilder::build(ind_t nb_col, ind_t nb_primary,
+                                  size_t nb_rows, const ind_t *row_start,
+                                  const ind_t *cols, const ind_t *colors) {
+  nb_primary = std::min(nb_col, nb_primary);
+  const size_t nb_entries = row_start[nb_rows];
+  for (size_t i = 0; i < nb_rows; i++)
+    if (row_start[i] >= row_start[i + 1])
+      throw std::runtime_error("DLXMatrixBuilder : empty row");
+  if (nb_entries > 0 && *std::max_element(cols, cols + nb_entries) >= nb_col)
+    throw std::out_of_range("DLXMatrixBuilder : column out of range");
+  bool colored = false;
+  for (size_t k = 0; colors && k < nb_entries; k++) {
+    if (colors[k] == 0) continue;
+    if (cols[k] < nb_primary)
+      throw std::runtime_error("DLXMatrixBuilder : colored primary item");
+    if (colors[k] == DLXMatrix::purified)
+      throw std::out_of_range("DLXMatrixBuilder : color out of range");
+    colored = true;
+  }
+
+  using Node = DLXMatrix::Node;
+  using Header = DLXMatrix::Header;
+  DLXMatrix res(nb_col, nb_primary);
+  res.colored_ = colored;
+  if (colored) {
+    res.colors_.assign(colors, colors + nb_entries);
+    res.col_colors_.assign(nb_col + 1, 0);
+    res.color_start_.assign(row_start, row_start + nb_rows);
+  }
+  res.rows_.reserve(nb_rows);
+  Node *nodes = res.new_nodes(nb_entries);
+  for (ind_t row_id = 0; row_id < nb_rows; row_id++) {
+    ind_t start = row_start[row_id], size = row_start[row_id + 1] - start;
+    Node *row = nodes + start;
+    res.rows_.emplace_back(row, size);
+    for (ind_t i = 0; i < size; i++) {
+      Node &nd = row[i];
+      Header &h = res.heads_[cols[start + i] + 1];
+      h.size++;
+      nd.row_id = row_id;
+      nd.head = &h;
+      nd.up = h.node.up;
+      h.node.up = &nd;
+      nd.left = &row[i == 0 ? size - 1 : i - 1];
+      nd.right = &row[i == size - 1 ? 0 : i + 1];
+    }
+  }
+  for (Node *nd = nodes + nb_entries; nd != nodes;) {
+    --nd;
+    nd->down = nd->head->node.down;
+    nd->head->node.down = nd;
+  }
+  return res;
+}
+TEST_CASE("Method DLXMatrixBuilder::finalize") {
+  SUBCASE("Same matrix as add_row_sparse") {
+    for (ind_t N = 1; N < 8; N++) {
+      DLXMatrix M = Langford_matrix(N);
+      DLXMatrixBuilder B(M.nb_cols(), M.nb_primary());
+      for (ind_t i = 0; i < M.nb_rows(); i++) B.add_row(M.ith_row_sparse(i));
+      DLXMatrix MB = B.finalize();
+      CHECK(B.nb_rows() == 0);
+      CHECK(B.nb_entries() == 0);
+      CHECK(MB.nb_cols() == M.nb_cols());
+      CHECK(MB.nb_primary() == M.nb_primary());
+      REQUIRE(MB.nb_rows() == M.nb_rows());
+      for (ind_t i = 0; i < M.nb_rows(); i++)
+        CHECK(MB.ith_row_sparse(i) == M.ith_row_sparse(i));
+      CHECK_NOTHROW(MB.check_sizes());
+      CHECK(MB.search_rec() == M.search_rec());
+      // The builder is ready for another matrix
+      B.add_row({0});
+      CHECK(B.finalize().nb_rows() == 1);
+    }
+  }
+  SUBCASE("Colors") {
+    DLXMatrixBuilder B(3, 1);
+    B.add_row({0, 1}, {0, 1});
+    B.add_row({0, 1, 2}, {0, 1, 0});
+    B.add_row({0, 2});
+    DLXMatrix M = B.finalize();
+    CHECK(M.has_colors());
+    CHECK(M.kernel_threshold() == 0);
+    CHECK(M.ith_row_colors(0) == Vect1D({0, 1}));
+    CHECK(M.ith_row_colors(2) == Vect1D({0, 0}));
+    CHECK(normalize_solutions(M.search_rec()) == Vect2D({{0}, {1}, {2}}));
+    // Adding rows afterward
+    CHECK(M.add_row_sparse({0, 1}, {0, 2}) == 3);
+    CHECK_NOTHROW(M.check_sizes());
+    CHECK(M.count_solutions() == 4);
+  }
+  SUBCASE("Errors") {
+    DLXMatrixBuilder B(3, 1);
+    B.add_row({0, 1});
+    B.add_item(2);
+    CHECK_THROWS_WITH_AS(B.finalize(), "DLXMatrixBuilder : unfinished row",
+                         std::runtime_error);
+    B.end_row();
+    B.end_row();
+    CHECK_THROWS_WITH_AS(B.finalize(), "DLXMatrixBuilder : empty row",
+                         std::runtime_error);
+    B = DLXMatrixBuilder(3, 1);
+    B.add_row({0, 3});
+    CHECK_THROWS_WITH_AS(B.finalize(),
+                         "DLXMatrixBuilder : column out of range",
+                         std::out_of_range);
+    B = DLXMatrixBuilder(3, 1);
+    B.add_row({0, 1}, {1, 0});
+    CHECK_THROWS_WITH_AS(B.finalize(),
+                         "DLXMatrixBuilder : colored primary item",
+                         std::runtime_error);
+  }
+  SUBCASE("Caller's arrays") {
+    const ind_t row_start[] = {0, 2, 3, 5}, cols[] = {0, 1, 2, 1, 2};
+    DLXMatrix M = DLXMatrixBuilder::build(3, 3, 3, row_start, cols);
+    CHECK(M.ith_row_sparse(2) == Vect1D({1, 2}));
+    CHECK(normalize_solutions(M.search_rec()) == Vect2D({{0, 1}}));
+    const ind_t bad_start[] = {0, 2, 2, 5};
+    CHECK_THROWS_WITH_AS(DLXMatrixBuilder::build(3, 3, 3, bad_start, cols),
+                         "DLXMatrixBuilder : empty row", std::runtime_error);
+  }
+  SUBCASE("Empty") {
+    DLXMatrixBuilder B(4);
+    DLXMatrix M = B.finalize();
+    CHECK(M.nb_cols() == 4);
+    CHECK(M.nb_rows() == 0);
+    CHECK(M.count_solutions() == 0);
+    CHECK(DLXMatrixBuilder(0).finalize().count_solutions() == 1);
+  }
+}
+
+/////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_matrix]class DLXMatrixBuilder";
+/////////////////////////////////////////////////////
+
 /////////////////////////////////////////////////////
 TEST_SUITE_BEGIN("[dlx_matrix]class DLXMatrixNamed");
 /////////////////////////////////////////////////////
@@ -879,8 +2752,246 @@ TEST_CASE("Constructor") {
                        "DLXMatrixIdent : Duplicate item", std::runtime_error);
 }
 
+TEST_CASE("Constructor from a DLXMatrix") {
+  DLXMatrixNamed M({"A", "B", "C", "D"}, {"rowAB", "rowAC", "rowCD"},
+                   DLXMatrix(4, 3, {{0, 1}, {0, 2}, {2, 3}}));
+  CHECK(M.nb_primary() == 3);
+  CHECK(M.items() == std::vector<std::string>({"A", "B", "C", "D"}));
+  CHECK(M.opt_ids() ==
+        std::vector<std::string>({"rowAB", "rowAC", "rowCD"}));
+  CHECK(M.ith_opt(1) == DLXMatrixNamed::Option({"A", "C"}));
+  CHECK(M.get_opt_ind("rowCD") == 2);
+  CHECK(M.search_iter());
+  CHECK(M.get_solution() == std::vector<std::string>({"rowAB", "rowCD"}));
+  CHECK_THROWS_WITH_AS(
+      DLXMatrixNamed({"A", "B"}, {"rowAB"}, DLXMatrix(3, {{0, 1}})),
+      "DLXMatrixIdent : size mismatch", std::runtime_error);
+}
+
+TEST_CASE("Methods get_opt_ind, choose_all and is_*_active") {
+  // clang-format off
+  DLXMatrixNamed M({"A", "B", "C", "D"},
+                   { {"rowAB", {"A", "B"}},
+                     {"rowAC", {"A", "C"}},
+                     {"rowCD", {"C", "D"}},
+                     {"rowBD", {"B", "D"}},
+                     {"rowAB", {"A", "D"}} });  // same id as row 0
+  // clang-format on
+  CHECK(M.get_opt_ind("rowAC") == 1);
+  CHECK(M.get_opt_ind("rowAB") == 0);
+  CHECK_THROWS_AS(M.get_opt_ind("rowXX"), std::runtime_error);
+  CHECK(M.is_item_active("A"));
+  CHECK(M.is_opt_active("rowBD"));
+  CHECK(M.choose_all(std::vector<std::string>({"rowAB", "rowCD"})));
+  CHECK(M.depth() == 2);
+  for (const char *item : {"A", "B", "C", "D"}) CHECK(!M.is_item_active(item));
+  CHECK(!M.is_opt_active("rowBD"));
+  CHECK(M.is_solution(M.get_solution()));
+  M.reset();
+  CHECK(M.choose_all(std::vector<std::string>({"rowAC"})));
+  CHECK(M.is_item_active("B"));
+  CHECK(!M.is_item_active("C"));
+  CHECK(M.is_opt_active("rowBD"));
+  CHECK(!M.is_opt_active("rowCD"));
+  // rowCD conflicts with rowAC
+  CHECK(!M.choose_all(std::vector<std::string>({"rowBD", "rowCD"})));
+  CHECK(M.depth() == 1);
+  CHECK(M.is_opt_active("rowBD"));
+  CHECK_THROWS_AS(M.choose_all(std::vector<std::string>({"rowXX"})),
+                  std::runtime_error);
+}
+
+TEST_CASE("Method add_opt with colors") {
+  // Two tiles must agree on the shared edge "E"
+  DLXMatrixNamed M({"T1", "T2", "E"}, 2);
+  M.add_opt("T1red", {"T1", "E"}, {0, 1});
+  M.add_opt("T1blue", {"T1", "E"}, {0, 2});
+  M.add_opt("T2blue", {"T2", "E"}, {0, 2});
+  CHECK(M.has_colors());
+  CHECK(M.ith_row_colors(1) == Vect1D({0, 2}));
+  CHECK_THROWS_AS(M.add_opt("T3", {"T3", "E"}, {0, 1}), std::out_of_range);
+  CHECK(M.nb_opts() == 3);
+  CHECK(M.search_iter());
+  CHECK(M.get_solution() == std::vector<std::string>({"T2blue", "T1blue"}));
+  CHECK_FALSE(M.search_iter());
+  CHECK(M.is_solution({"T1blue", "T2blue"}));
+  CHECK_FALSE(M.is_solution({"T1red", "T2blue"}));
+}
+
+TEST_CASE("Method search_visit") {
+  // clang-format off
+  DLXMatrixNamed M({"A", "B", "C", "D"},
+                   { {"rowAB", {"A", "B"}},
+                     {"rowAC", {"A", "C"}},
+                     {"rowCD", {"C", "D"}},
+                     {"rowBD", {"B", "D"}} });
+  // clang-format on
+  std::vector<std::string> names;
+  CHECK(M.search_visit([&M, &names](DLXMatrixNamed::SolutionView sol) {
+    for (auto i : sol) names.push_back(M.get_opt_id(i));
+  }) == 2);
+  CHECK(names ==
+        std::vector<std::string>({"rowAB", "rowCD", "rowAC", "rowBD"}));
+}
+
+TEST_CASE("Method search_random") {
+  // clang-format off
+  DLXMatrixNamed M({"A", "B", "C", "D"},
+                   { {"rowAB", {"A", "B"}},
+                     {"rowAC", {"A", "C"}},
+                     {"rowCD", {"C", "D"}},
+                     {"rowBD", {"B", "D"}} });
+  // clang-format on
+  std::vector<std::string> sol;
+  for (int i = 0; i < 10; i++) {
+    REQUIRE(M.search_random(sol));
+    CHECK(M.is_solution(sol));
+  }
+  DLXMatrixNamed N({"A", "B"}, {{"rowA", {"A"}}});
+  CHECK_FALSE(N.search_random(sol));
+}
+
 /////////////////////////////////////////////////////////
 TEST_SUITE_END();  // "[dlx_matrix]class DLXMatrixNamed";
 /////////////////////////////////////////////////////////
 
+////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_matrix]Item indexers");
+////////////////////////////////////////////////
+
+using Triple = std::tuple<char, int, int>;
+
+template <typename Indexer>
+static void check_triple_indexer() {
+  std::vector<Triple> items;
+  for (char c : {'s', 'b', 'r'})
+    for (int i = 1; i <= 4; i++)
+      for (int j = -2; j <= 2; j++) items.emplace_back(c, i, j);
+  Indexer ind(items);
+  for (size_t i = 0; i < items.size(); i++) CHECK(ind.at(items[i]) == i);
+  CHECK_THROWS_AS(ind.at({'c', 1, 1}), std::out_of_range);
+  CHECK_THROWS_AS(ind.at({'r', 5, 1}), std::out_of_range);
+  CHECK_THROWS_AS(ind.at({'r', 1, -3}), std::out_of_range);
+  items.emplace_back('b', 2, 2);
+  CHECK_THROWS_WITH_AS(Indexer{items}, "DLXMatrixIdent : Duplicate item",
+                       std::runtime_error);
+  Indexer empty(std::vector<Triple>{});
+  CHECK_THROWS_AS(empty.at({'r', 1, 1}), std::out_of_range);
+}
+TEST_CASE("Class HashIndexer") {
+  check_triple_indexer<HashIndexer<Triple, hash_tuple::hash<Triple>>>();
+}
+TEST_CASE("Class FlatHashIndexer") {
+  check_triple_indexer<FlatHashIndexer<Triple, hash_tuple::hash<Triple>>>();
+  std::vector<int> items;
+  for (int i = 0; i < 1000; i++) items.push_back(1024 * i);  // same low bits
+  FlatHashIndexer<int> ind(items);
+  for (int i = 0; i < 1000; i++) CHECK(ind.at(1024 * i) == ind_t(i));
+  CHECK_THROWS_AS(ind.at(1), std::out_of_range);
+}
+TEST_CASE("Class RangeIndexer") {
+  check_triple_indexer<RangeIndexer<Triple>>();
+  RangeIndexer<int> ind(std::vector<int>{5, 3, 9});
+  CHECK(ind.at(5) == 0);
+  CHECK(ind.at(3) == 1);
+  CHECK(ind.at(9) == 2);
+  CHECK_THROWS_AS(ind.at(4), std::out_of_range);
+  CHECK_THROWS_WITH_AS(RangeIndexer<int>(std::vector<int>{0, 1000000}),
+                       "DLXMatrixIdent : item ranges too large",
+                       std::runtime_error);
+}
+TEST_CASE("DLXMatrixIdent with indexers") {
+  using Pair = std::tuple<int, int>;
+  // Dominoes on a 2x3 board
+  std::vector<Pair> cells;
+  for (int r = 0; r < 2; r++)
+    for (int c = 0; c < 3; c++) cells.emplace_back(r, c);
+  std::vector<std::pair<std::string, std::vector<Pair>>> opts;
+  for (int r = 0; r < 2; r++)
+    for (int c = 0; c < 3; c++) {
+      std::string name = std::to_string(r) + std::to_string(c);
+      if (r + 1 < 2) opts.push_back({name + "v", {{r, c}, {r + 1, c}}});
+      if (c + 1 < 3) opts.push_back({name + "h", {{r, c}, {r, c + 1}}});
+    }
+  DLXMatrixIdent<Pair, std::string, RangeIndexer<Pair>> MR(cells, opts);
+  DLXMatrixIdent<Pair, std::string,
+                 FlatHashIndexer<Pair, hash_tuple::hash<Pair>>> MF(cells, opts);
+  DLXMatrixIdent<Pair, std::string, hash_tuple::hash<Pair>> MH(cells, opts);
+  CHECK(MR.count_solutions() == 3);
+  CHECK(MF.count_solutions() == 3);
+  CHECK(MH.count_solutions() == 3);
+  CHECK(MR.is_item_active({1, 2}));
+  CHECK_THROWS_AS(MR.add_opt("bad", {{0, 0}, {2, 0}}), std::out_of_range);
+  CHECK(MR.nb_opts() == opts.size());
+  // Option ids with their own hash, the domino given by its first cell
+  DLXMatrixIdent<Pair, Pair, RangeIndexer<Pair>, hash_tuple::hash<Pair>> MP(
+      cells);
+  MP.add_opt({0, 0}, {{0, 0}, {0, 1}});
+  MP.add_opt({1, 0}, {{1, 0}, {1, 1}});
+  CHECK(MP.get_opt_ind({1, 0}) == 1);
+  std::ostringstream out;
+  out << MP;
+  CHECK(out.str() == MP.to_string());
+}
+
+//////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_matrix]Item indexers";
+//////////////////////////////////////////////
+
+/////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_matrix]class DLXSearch");
+/////////////////////////////////////////////////
+
+TEST_CASE_FIXTURE(DLXMatrixFixture, "DLXSearch as a range") {
+  for (const DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    DLXMatrix MSave(M);
+    DLXSearch<DLXMatrix> S(M);
+    Vect2D sols;
+    for (const Vect1D &s : S) sols.push_back(s);
+    CHECK(sols == MSave.search_rec());
+    CHECK(S.done());
+    CHECK(S.begin() == S.end());
+  }
+}
+
+TEST_CASE("DLXSearch round robin") {
+  std::vector<DLXSearch<DLXMatrix>> searches;
+  for (ind_t N : {7, 8, 4, 3})
+    searches.emplace_back(Langford_matrix(N));
+  std::vector<size_t> counts(searches.size());
+  size_t nb_running = searches.size(), nb_rounds = 0;
+  while (nb_running > 0) {
+    nb_rounds++;
+    nb_running = 0;
+    for (size_t i = 0; i < searches.size(); i++) {
+      if (searches[i].done()) continue;
+      if (searches[i].resume(50) == SearchStatus::solution) counts[i]++;
+      if (!searches[i].done()) nb_running++;
+    }
+  }
+  CHECK(counts == std::vector<size_t>({52, 300, 2, 2}));
+  CHECK(nb_rounds > 10);
+  for (auto &S : searches) CHECK(S.resume() == SearchStatus::finished);
+}
+
+TEST_CASE("DLXSearch on DLXMatrixNamed") {
+  // clang-format off
+  DLXSearch<DLXMatrixNamed> S(DLXMatrixNamed(
+      {"A", "B", "C", "D"},
+      { {"rowAB", {"A", "B"}}, {"rowAC", {"A", "C"}},
+        {"rowCD", {"C", "D"}}, {"rowBD", {"B", "D"}} }));
+  // clang-format on
+  CHECK(S.status() == SearchStatus::suspended);
+  CHECK(S.resume() == SearchStatus::solution);
+  CHECK(S.solution() == std::vector<std::string>({"rowAB", "rowCD"}));
+  std::vector<std::vector<std::string>> rest(S.begin(), S.end());
+  CHECK(rest == std::vector<std::vector<std::string>>({{"rowAC", "rowBD"}}));
+  CHECK(S.done());
+}
+
+///////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_matrix]class DLXSearch";
+///////////////////////////////////////////////////
+
 }  // namespace DLX_backtrack
@@ -19,12 +19,22 @@
 #define DLX_MATRIX_HPP_
 
 #include <algorithm>      // transform
+#include <array>          // array
+#include <atomic>         // atomic
+#include <chrono>         // steady_clock
+#include <cstddef>        // ptrdiff_t
+#include <cstdint>        // uint64_t
 #include <iostream>       // cout
+#include <iterator>       // forward_iterator_tag, input_iterator_tag
 #include <limits>         // numeric_limits
+#include <memory>         // unique_ptr
+#include <random>         // mt19937, uniform_int_distribution
+#include <stdexcept>      // out_of_range, runtime_error
 #include <string>         //
-#include <tuple>          // tie, ignore
-#include <type_traits>    // invoke_result_t
+#include <tuple>          // tie, ignore, apply, tuple_size
+#include <type_traits>    // invoke_result_t, enable_if_t, is_base_of, void_t
 #include <unordered_map>  //
+#include <utility>        // declval, move, pair
 #include <vector>         //
 
 #define DLX_INLINE __attribute__((always_inline)) inline
@@ -44,6 +54,14 @@ inline std::vector<std::invoke_result_t<Fun, A>> vector_transform(
 
 };
 
+// Outcome of a budgeted search step
+enum class SearchStatus {
+  solution,   // a solution was found, the search can be resumed
+  finished,   // the whole tree was explored, there is no more solution
+  suspended,  // the budget is spent, the search can be resumed
+  cancelled   // the stop token was set, the search can be resumed
+};
+
 /////////////////
 class DLXMatrix {
  public:
@@ -62,17 +80,110 @@ class DLXMatrix {
     Node node;
     Header *left, *right;
   };
+  static constexpr ind_t purified = std::numeric_limits<ind_t>::max();
+  // row_id of the nodes of the headers
+  static constexpr ind_t header_row = std::numeric_limits<ind_t>::max();
+
+  // The nodes of a row, which are contiguous in one of the node blocks
+  class Row {
+    Node *begin_, *end_;
+
+   public:
+    Row(Node *begin, size_t size) : begin_(begin), end_(begin + size) {}
+    size_t size() const { return end_ - begin_; }
+    Node *data() const { return begin_; }
+    Node *begin() const { return begin_; }
+    Node *end() const { return end_; }
+    Node &operator[](size_t i) const { return begin_[i]; }
+    Node &back() const { return end_[-1]; }
+  };
 
   ind_t nb_primary_, depth_;
   std::vector<Header> heads_;
-  std::vector<std::vector<Node>> rows_;
+  std::vector<Row> rows_;
+  // The nodes never move: add_row_sparse carves the rows in blocks of
+  // growing size, a copy or a DLXMatrixBuilder puts all of them in a single
+  // block.
+  std::vector<std::unique_ptr<Node[]>> blocks_;
+  size_t nb_nodes_;
+  Node *free_;  // the nb_free_ unused nodes at the end of the last block
+  size_t nb_free_;
+  // Changes with the nodes, on construction, copy and add_row: a snapshot
+  // is only restored on the matrix with its generation
+  uint64_t generation_;
+  static uint64_t new_generation();
 
   std::vector<Node *> work_;
   bool search_down_;
 
+  // The recursive search switches to a bitset kernel when there are at most
+  // kernel_threshold_ active columns (0 disables the switch).
+  ind_t nb_active_cols_, kernel_threshold_;
+  std::vector<ind_t> kernel_cols_;  // Scratch: column id -> kernel column
+  bool colored_;  // some secondary item has a color in some row
+  // Only allocated once colored_ is set, so that the nodes of the uncolored
+  // matrices stay small. colors_ holds the color of each node, row after row
+  // starting at color_start_[row_id]: 0 if no color, purified when compatible
+  // with the choices. col_colors_ holds the color of the choices of each
+  // purified column, indexed as heads_.
+  std::vector<ind_t> colors_, col_colors_;
+  std::vector<size_t> color_start_;
+  bool multiplicities_;  // some primary item has bounds other than [1, 1]
+  // Multiplicity of primary items, as in Knuth's Algorithm M, indexed as
+  // heads_: the item may still be used bound times and must be used at least
+  // bound - slack times. They are kept out of the headers which the other
+  // searches walk through.
+  std::vector<ind_t> bounds_, slacks_;
+
+  // Optional bucket queue of the active primary columns by size. Bucket s is
+  // a circular list of column ids chained by bucket_next_ / bucket_prev_,
+  // whose head is the entry nb_primary_ + s.
+  bool buckets_;
+  std::vector<ind_t> bucket_next_, bucket_prev_;
+  ind_t bucket_min_;  // no active primary column is smaller
+
+  std::vector<std::vector<ind_t>> symmetries_;  // generators on the columns
+
  public:
   using Vect1D = std::vector<ind_t>;
   using Vect2D = std::vector<Vect1D>;
+  using count_t = unsigned __int128;  // Solution counts
+
+  // Read-only view of the row ids of the current solution. It refers to the
+  // internal choice stack, so it is only valid until the search moves on.
+  class SolutionView {
+    const Node *const *begin_, *const *end_;
+
+   public:
+    class iterator {
+      const Node *const *p_;
+
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = ind_t;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const ind_t *;
+      using reference = ind_t;
+      explicit iterator(const Node *const *p) : p_(p) {}
+      ind_t operator*() const { return (*p_)->row_id; }
+      iterator &operator++() {
+        ++p_;
+        return *this;
+      }
+      iterator operator++(int) { return iterator(p_++); }
+      bool operator==(const iterator &other) const { return p_ == other.p_; }
+      bool operator!=(const iterator &other) const { return p_ != other.p_; }
+    };
+
+    explicit SolutionView(const std::vector<Node *> &work)
+        : begin_(work.data()), end_(work.data() + work.size()) {}
+    size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    ind_t operator[](size_t i) const { return begin_[i]->row_id; }
+    iterator begin() const { return iterator(begin_); }
+    iterator end() const { return iterator(end_); }
+    Vect1D to_vector() const { return Vect1D(begin(), end()); }
+  };
 
   DLXMatrix() : DLXMatrix(0) {}
   explicit DLXMatrix(ind_t nb_col) : DLXMatrix(nb_col, nb_col) {}
@@ -94,9 +205,22 @@ class DLXMatrix {
 
   ind_t add_row(const Vect1D &r) { return add_row_sparse(r); }
   ind_t add_row_sparse(const Vect1D &r);
+  // colors[i] is the color of item r[i], 0 meaning no color. Only secondary
+  // items may have a color: rows sharing a colored item are compatible if
+  // they give it the same color.
+  ind_t add_row_sparse(const Vect1D &r, const Vect1D &colors);
   ind_t add_row_dense(const std::vector<bool> &r);
   Vect1D ith_row_sparse(ind_t i) const;
+  Vect1D ith_row_colors(ind_t i) const;
   std::vector<bool> ith_row_dense(ind_t i) const;
+  bool has_colors() const { return colored_; }
+
+  // Primary item i must be used between lo and hi times. This is only
+  // supported by search_rec and count_solutions, and must be set before any
+  // choice is made.
+  void set_multiplicity(ind_t i, ind_t lo, ind_t hi);
+  std::pair<ind_t, ind_t> multiplicity(ind_t i) const;
+  bool has_multiplicities() const { return multiplicities_; }
 
   Vect1D row_to_sparse(const std::vector<bool> &row) const;
   std::vector<bool> row_to_dense(Vect1D row) const;
@@ -104,16 +228,109 @@ class DLXMatrix {
   ind_t choose(ind_t i);
 
   Vect2D search_rec(size_t max_sol = std::numeric_limits<size_t>::max());
+  count_t count_solutions();
+  count_t count_up_to(count_t max_sol);
+
+  // Column choice heuristics, given to search_rec and count_solutions as a
+  // policy. A heuristic is called as heur(M) and returns the active primary
+  // column to branch on; user defined ones derive from Heuristic. The bitset
+  // kernel and the search with multiplicities keep their own choice.
+  struct Heuristic;
+  struct MinSize;        // Knuth's MRV: the first column of minimum size
+  struct MinSizeEarly;   // MinSize, stopping at the first size 0 or 1
+  struct MinSizeLength;  // MinSize, ties go to the longest rows
+  struct SharpFirst;     // MinSize on the flagged columns first (Knuth's #)
+  struct MinSizeRandom;  // MinSize, ties broken at random
+  template <typename Heur>
+  using if_heuristic =
+      std::enable_if_t<std::is_base_of<Heuristic, Heur>::value, int>;
+  template <typename Heur, if_heuristic<Heur> = 0>
+  Vect2D search_rec(Heur heur,
+                    size_t max_sol = std::numeric_limits<size_t>::max());
+  template <typename Heur, if_heuristic<Heur> = 0>
+  count_t count_solutions(Heur heur);
+  template <typename Heur, if_heuristic<Heur> = 0>
+  count_t count_up_to(Heur heur, count_t max_sol);
   bool search_iter();
   bool search_iter(Vect1D &);
+  SearchStatus search_step(unsigned long max_choices);
+  // Budgets of a search step, counted from the start of the step. The clock
+  // and the stop token are only looked at every poll_interval choices.
+  struct SearchLimits {
+    unsigned long max_choices = std::numeric_limits<unsigned long>::max();
+    unsigned long max_dances = std::numeric_limits<unsigned long>::max();
+    std::chrono::steady_clock::duration max_time =
+        std::chrono::steady_clock::duration::max();
+    const std::atomic<bool> *stop = nullptr;
+  };
+  static constexpr unsigned long poll_interval = 1024;
+  SearchStatus search_step(const SearchLimits &limits);
+  // Count the solutions with search_step until finished or out of budget,
+  // adding them to count. Unlike count_solutions, it can be resumed.
+  SearchStatus count_step(const SearchLimits &limits, count_t &count);
+  template <typename Visitor>
+  size_t search_visit(Visitor &&visit);
   Vect1D get_solution();
+  SolutionView solution_view() const { return SolutionView(work_); }
   bool search_random(Vect1D &);
   bool is_solution(const Vect1D &) const;
+  Vect2D subproblems(size_t depth);
+
+  // Symmetries of the problem, given by the permutation of the columns,
+  // col_perm[i] being the image of column i, which must map the rows onto
+  // the rows. The following searches only explore one branch for each
+  // orbit of the symmetries which fix the current choices, and give each
+  // solution found the number of solutions it stands for. Symmetries are
+  // not available with colors nor multiplicities.
+  static constexpr size_t max_symmetries = 1 << 16;  // order of the group
+  void add_symmetry(const Vect1D &col_perm);
+  void clear_symmetries() { symmetries_.clear(); }
+  size_t nb_symmetries() const { return symmetry_group().size(); }
+  count_t count_solutions_sym();
+  std::vector<std::pair<Vect1D, count_t>> search_orbits();
 
   bool is_row_active(ind_t i) const { return is_active(rows_.at(i).data()); }
   bool is_col_active(ind_t i) const { return is_active(&heads_.at(i + 1)); }
 
   void reset(size_t depth = 0);
+  size_t depth() const { return depth_; }
+
+  // Saved links and search state. Restoring copies them back in bulk instead
+  // of unwinding the choices one by one; as reset, it clears the statistics.
+  // A snapshot is only valid for the matrix it was taken from, as long as no
+  // row is added.
+  class Snapshot;
+  Snapshot snapshot() const;
+  void restore(const Snapshot &snap);
+
+  // Checkpoint of the position of search_iter / search_step: the stack of
+  // chosen rows and the statistics, in a small text format. Loading replays
+  // the choices on a matrix with the same rows, and the search goes on from
+  // there without exploring again the finished subtrees. A 64 bits
+  // fingerprint of the rows and their colors rejects the other matrices.
+  void save_checkpoint(std::ostream &out) const;
+  void load_checkpoint(std::istream &in);
+
+  static constexpr size_t max_kernel_cols = 256;
+  size_t kernel_threshold() const { return kernel_threshold_; }
+  // The kernel is entered once per subtree and extracts its rows, so that it
+  // pays off with a large threshold: with max_kernel_cols, the counts of
+  // Langford pairings and pentomino tilings run 2 to 5 times faster (make
+  // bench-kernel). It doesn't know about colors nor multiplicities and is
+  // disabled for them.
+  void set_kernel_threshold(size_t nb_cols) {
+    kernel_threshold_ = colored_ || multiplicities_
+                            ? 0
+                            : std::min(nb_cols, max_kernel_cols);
+  }
+  // Keep the primary columns sorted by size in a bucket queue, so that a
+  // minimum size column is found without scanning all the active ones. This
+  // pays off on wide matrices, at the price of some work in each dance. The
+  // ties are not broken in column order and depend on the past of the
+  // search, so the solutions come in another order. Not available with
+  // multiplicities.
+  void set_bucket_queue(bool enable);
+  bool bucket_queue() const { return buckets_; }
 
   DLXMatrix permuted_columns(const Vect1D &perm) const;
   DLXMatrix permuted_inv_columns(const Vect1D &perm) const;
@@ -136,21 +353,439 @@ class DLXMatrix {
   bool is_active(const Node *nd) const;
   bool is_active(const Header *h) const;
 
-  Vect1D row_sparse(const std::vector<Node> &) const;
-  std::vector<bool> row_dense(const std::vector<Node> &) const;
+  Vect1D row_sparse(const Row &) const;
+  Vect1D row_colors(const Row &) const;
+  size_t color_index(const Node *n) const {
+    return color_start_[n->row_id] + (n - rows_[n->row_id].data());
+  }
+  ind_t &color(const Node *n) { return colors_[color_index(n)]; }
+  ind_t &color(const Header *h) { return col_colors_[h - heads_.data()]; }
+  ind_t &bound(const Header *h) { return bounds_[h - heads_.data()]; }
+  ind_t &slack(const Header *h) { return slacks_[h - heads_.data()]; }
+  ind_t get_color(const Node *n) const {
+    if (!colored_) return 0;
+    ind_t res = colors_[color_index(n)];
+    return res == purified ? col_colors_[n->head - heads_.data()] : res;
+  }
+  std::vector<bool> row_dense(const Row &) const;
 
  private:
+  friend class DLXMatrixBuilder;
+  Node *new_nodes(size_t nb);
+  ind_t add_row_internal(const Vect1D &r, const ind_t *colors);
 
   Header *choose_min();
+  void build_buckets();
+  DLX_INLINE void bucket_remove(ind_t i);
+  DLX_INLINE void bucket_insert(ind_t i, ind_t size);
+  DLX_INLINE void bucket_update(Header *h);
+  // The rows dance in one of four variants, so that the matrices without
+  // colors or buckets don't test for them on each node. The untemplated
+  // versions dispatch on colored_ and buckets_.
+  template <bool Colored, bool Buckets>
+  DLX_INLINE void hide(Node *row);
+  template <bool Colored, bool Buckets>
+  DLX_INLINE void unhide(Node *row);
+  template <bool Colored, bool Buckets>
+  DLX_INLINE void hide_rows(Header *col);
+  template <bool Colored, bool Buckets>
+  DLX_INLINE void unhide_rows(Header *col);
   DLX_INLINE void hide(Node *row);
   DLX_INLINE void unhide(Node *row);
   DLX_INLINE void cover(Header *col);
   DLX_INLINE void uncover(Header *col);
+  DLX_INLINE void purify(Node *nd);
+  DLX_INLINE void unpurify(Node *nd);
+  DLX_INLINE void commit(Node *nd);
+  DLX_INLINE void uncommit(Node *nd);
   DLX_INLINE void choose(Node *nd);
   DLX_INLINE void unchoose(Node *nd);
-  void search_rec_internal(size_t, Vect2D &);
+  template <typename Heur>
+  void search_rec_internal(Heur &, size_t, Vect2D &);
+  template <typename Heur>
+  void count_internal(Heur &, count_t, count_t &);
+  // The parts of the searches with a heuristic which don't depend on it
+  void search_rec_mcc(size_t, Vect2D &);
+  void search_rec_kernel(size_t, Vect2D &);
+  void count_mcc(count_t, count_t &);
+  void count_kernel(count_t, count_t &);
+  void subproblems_internal(size_t, Vect1D &, Vect2D &);
+  template <size_t NBits, typename Report>
+  bool search_kernel(Report &report);
+  // search_step limits as absolute values
+  struct StepStops {
+    unsigned long choices, dances, poll;
+    std::chrono::steady_clock::time_point deadline;
+    const std::atomic<bool> *stop;
+  };
+  StepStops step_stops(const SearchLimits &limits) const;
+  // method is the name of the caller, for the error messages
+  SearchStatus search_until(StepStops &stops, const char *method);
+
+  struct Symmetry {
+    Vect1D cols, rows;  // images of the columns and of the rows
+  };
+  Vect1D symmetry_rows(const Vect1D &col_perm) const;
+  std::vector<Symmetry> symmetry_group() const;
+  template <typename Report>
+  void search_sym(Report &report);
+  template <typename Report>
+  void search_sym(const std::vector<const Symmetry *> &group, count_t weight,
+                  Report &report);
+
+  void check_no_multiplicities(const char *method) const;
+  uint64_t fingerprint() const;  // of the rows and their colors
+  DLX_INLINE void tweak(Node *nd);
+  DLX_INLINE void untweak(Header *col, Node *first, Node *stop);
+  DLX_INLINE void choose_mcc(Node *nd);
+  DLX_INLINE void unchoose_mcc(Node *nd);
+  template <typename Report>
+  bool search_mcc(Report &report);
+};
+
+class DLXMatrix::Snapshot {
+  friend class DLXMatrix;
+  uint64_t generation_;  // identifies the matrix
+  std::vector<Header> heads_;
+  std::vector<Node> nodes_;  // all the rows one after the other
+  std::vector<ind_t> colors_, col_colors_;
+  std::vector<Node *> work_;
+  size_t depth_;
+  bool search_down_;
+  ind_t nb_active_cols_;
+  bool multiplicities_;
+  std::vector<ind_t> bounds_, slacks_;
+  bool buckets_;
+  std::vector<ind_t> bucket_next_, bucket_prev_;
+  ind_t bucket_min_;
+};
+
+// Column choice heuristics
+////////////////////////////
+struct DLXMatrix::Heuristic {
+ protected:
+  using Header = DLXMatrix::Header;
+  static Header *first(DLXMatrix &M) { return M.master()->right; }
+  static bool is_primary(const DLXMatrix &M, const Header *h) {
+    return M.is_primary(h);
+  }
+  static ind_t col_id(const DLXMatrix &M, const Header *h) {
+    return M.get_col_id(h);
+  }
+  // Sum of the lengths of the active rows of a column
+  static ind_t rows_length(const DLXMatrix &M, const Header *h) {
+    ind_t res = 0;
+    for (const Node *p = h->node.down; p != &h->node; p = p->down)
+      res += M.rows_[p->row_id].size();
+    return res;
+  }
+};
+
+struct DLXMatrix::MinSize : Heuristic {
+  Header *operator()(DLXMatrix &M) const { return M.choose_min(); }
+};
+
+struct DLXMatrix::MinSizeEarly : Heuristic {
+  Header *operator()(DLXMatrix &M) const {
+    Header *choice = first(M);
+    for (Header *h = choice; is_primary(M, h); h = h->right) {
+      if (h->size < choice->size) choice = h;
+      if (choice->size <= 1) break;
+    }
+    return choice;
+  }
 };
 
+struct DLXMatrix::MinSizeLength : Heuristic {
+  Header *operator()(DLXMatrix &M) const {
+    Header *choice = first(M);
+    ind_t length = rows_length(M, choice);
+    for (Header *h = choice->right; is_primary(M, h); h = h->right) {
+      if (h->size > choice->size) continue;
+      ind_t len = rows_length(M, h);
+      if (h->size < choice->size || len > length) {
+        choice = h;
+        length = len;
+      }
+    }
+    return choice;
+  }
+};
+
+struct DLXMatrix::SharpFirst : Heuristic {
+  std::vector<bool> sharp;  // indexed by column id
+  SharpFirst() = default;
+  explicit SharpFirst(std::vector<bool> s) : sharp(std::move(s)) {}
+  Header *operator()(DLXMatrix &M) const {
+    Header *choice = nullptr, *sharp_choice = nullptr;
+    for (Header *h = first(M); is_primary(M, h); h = h->right) {
+      if (h->size == 0) return h;
+      ind_t i = col_id(M, h);
+      if (i < sharp.size() && sharp[i]) {
+        if (!sharp_choice || h->size < sharp_choice->size) sharp_choice = h;
+      } else if (!choice || h->size < choice->size) {
+        choice = h;
+      }
+    }
+    return sharp_choice ? sharp_choice : choice;
+  }
+};
+
+struct DLXMatrix::MinSizeRandom : Heuristic {
+  std::mt19937 rng;
+  explicit MinSizeRandom(std::mt19937::result_type seed = 0) : rng(seed) {}
+  Header *operator()(DLXMatrix &M) {
+    Header *choice = first(M);
+    ind_t nb_ties = 1;
+    for (Header *h = choice->right; is_primary(M, h); h = h->right) {
+      if (h->size < choice->size) {
+        choice = h;
+        nb_ties = 1;
+      } else if (h->size == choice->size &&
+                 std::uniform_int_distribution<ind_t>(0, nb_ties++)(rng) ==
+                     0) {
+        choice = h;
+      }
+    }
+    return choice;
+  }
+};
+
+// Dancing and searches with a heuristic
+//////////////////////////////////////////
+// They are in the header so that the searches can be instantiated with the
+// user defined heuristics.
+inline void DLXMatrix::bucket_remove(ind_t i) {
+  bucket_next_[bucket_prev_[i]] = bucket_next_[i];
+  bucket_prev_[bucket_next_[i]] = bucket_prev_[i];
+}
+inline void DLXMatrix::bucket_insert(ind_t i, ind_t size) {
+  ind_t head = nb_primary_ + size;
+  bucket_prev_[i] = head;
+  bucket_next_[i] = bucket_next_[head];
+  bucket_prev_[bucket_next_[head]] = i;
+  bucket_next_[head] = i;
+  if (size < bucket_min_) bucket_min_ = size;
+}
+inline void DLXMatrix::bucket_update(Header *h) {
+  ind_t i = get_col_id(h);
+  if (i >= nb_primary_) return;
+  bucket_remove(i);
+  bucket_insert(i, h->size);
+}
+
+template <bool Colored, bool Buckets>
+inline void DLXMatrix::hide(Node *row) {
+  for (Node *nr = row->right; nr != row; nr = nr->right) {
+    if constexpr (Colored)
+      if (color(nr) == purified) continue;
+    nr->up->down = nr->down;
+    nr->down->up = nr->up;
+    nr->head->size--;
+    if constexpr (Buckets) bucket_update(nr->head);
+    nb_dances++;
+  }
+}
+template <bool Colored, bool Buckets>
+inline void DLXMatrix::hide_rows(Header *col) {
+  for (Node *row = col->node.down; row != &col->node; row = row->down)
+    hide<Colored, Buckets>(row);
+}
+inline void DLXMatrix::hide(Node *row) {
+  if (colored_)
+    buckets_ ? hide<true, true>(row) : hide<true, false>(row);
+  else
+    buckets_ ? hide<false, true>(row) : hide<false, false>(row);
+}
+inline void DLXMatrix::cover(Header *col) {
+  col->left->right = col->right;
+  col->right->left = col->left;
+  nb_active_cols_--;
+  if (buckets_ && is_primary(col)) bucket_remove(get_col_id(col));
+  if (colored_)
+    buckets_ ? hide_rows<true, true>(col) : hide_rows<true, false>(col);
+  else
+    buckets_ ? hide_rows<false, true>(col) : hide_rows<false, false>(col);
+}
+// Knuth's purify: choosing a color for a secondary item hides the rows with
+// another color; the ones with the same color are marked and left in place.
+inline void DLXMatrix::purify(Node *nd) {
+  Header *col = nd->head;
+  const ind_t col_color = color(col) = color(nd);
+  for (Node *row = col->node.down; row != &col->node; row = row->down) {
+    if (color(row) == col_color) {
+      if (row != nd) color(row) = purified;
+    } else {
+      buckets_ ? hide<true, true>(row) : hide<true, false>(row);
+    }
+  }
+}
+inline void DLXMatrix::commit(Node *nd) {
+  if (!colored_) {
+    cover(nd->head);
+    return;
+  }
+  const ind_t nd_color = color(nd);
+  if (nd_color == 0)
+    cover(nd->head);
+  else if (nd_color != purified)
+    purify(nd);
+}
+inline void DLXMatrix::choose(Node *nd) {
+  nb_choices++;
+  work_.push_back(nd);
+  for (Node *nr = nd->right; nr != nd; nr = nr->right) commit(nr);
+}
+
+template <bool Colored, bool Buckets>
+inline void DLXMatrix::unhide(Node *row) {
+  for (Node *nr = row->left; nr != row; nr = nr->left) {
+    if constexpr (Colored)
+      if (color(nr) == purified) continue;
+    nr->head->size++;
+    if constexpr (Buckets) bucket_update(nr->head);
+    nr->up->down = nr;
+    nr->down->up = nr;
+  }
+}
+template <bool Colored, bool Buckets>
+inline void DLXMatrix::unhide_rows(Header *col) {
+  for (Node *row = col->node.up; row != &col->node; row = row->up)
+    unhide<Colored, Buckets>(row);
+}
+inline void DLXMatrix::unhide(Node *row) {
+  if (colored_)
+    buckets_ ? unhide<true, true>(row) : unhide<true, false>(row);
+  else
+    buckets_ ? unhide<false, true>(row) : unhide<false, false>(row);
+}
+inline void DLXMatrix::uncover(Header *col) {
+  col->left->right = col;
+  col->right->left = col;
+  nb_active_cols_++;
+  if (buckets_ && is_primary(col)) bucket_insert(get_col_id(col), col->size);
+  if (colored_)
+    buckets_ ? unhide_rows<true, true>(col) : unhide_rows<true, false>(col);
+  else
+    buckets_ ? unhide_rows<false, true>(col) : unhide_rows<false, false>(col);
+}
+inline void DLXMatrix::unpurify(Node *nd) {
+  Header *col = nd->head;
+  const ind_t col_color = color(col);
+  for (Node *row = col->node.up; row != &col->node; row = row->up) {
+    if (color(row) == purified)
+      color(row) = col_color;
+    else if (row != nd)
+      buckets_ ? unhide<true, true>(row) : unhide<true, false>(row);
+  }
+}
+inline void DLXMatrix::uncommit(Node *nd) {
+  if (!colored_) {
+    uncover(nd->head);
+    return;
+  }
+  const ind_t nd_color = color(nd);
+  if (nd_color == 0)
+    uncover(nd->head);
+  else if (nd_color != purified)
+    unpurify(nd);
+}
+inline void DLXMatrix::unchoose(Node *nd) {
+  for (Node *nr = nd->left; nr != nd; nr = nr->left) uncommit(nr);
+  work_.pop_back();
+}
+
+template <typename Heur, DLXMatrix::if_heuristic<Heur>>
+DLXMatrix::Vect2D DLXMatrix::search_rec(Heur heur, size_t max_sol) {
+  Vect2D res{};
+  nb_choices = nb_dances = 0;
+  if (multiplicities_)
+    search_rec_mcc(max_sol, res);
+  else
+    search_rec_internal(heur, max_sol, res);
+  return res;
+}
+template <typename Heur>
+void DLXMatrix::search_rec_internal(Heur &heur, size_t max_sol, Vect2D &res) {
+  if (!is_primary(master()->right)) {
+    res.push_back(get_solution());
+    return;
+  }
+  if (nb_active_cols_ <= kernel_threshold_) {
+    search_rec_kernel(max_sol, res);
+    return;
+  }
+
+  Header *choice = heur(*this);
+  if (choice->size == 0) return;
+
+  cover(choice);
+  for (Node *row = choice->node.down; row != &choice->node; row = row->down) {
+    choose(row);
+    search_rec_internal(heur, max_sol, res);
+    unchoose(row);
+    if (res.size() >= max_sol) break;
+  }
+  uncover(choice);
+}
+
+template <typename Heur, DLXMatrix::if_heuristic<Heur>>
+DLXMatrix::count_t DLXMatrix::count_solutions(Heur heur) {
+  return count_up_to(heur, std::numeric_limits<count_t>::max());
+}
+template <typename Heur, DLXMatrix::if_heuristic<Heur>>
+DLXMatrix::count_t DLXMatrix::count_up_to(Heur heur, count_t max_sol) {
+  count_t res = 0;
+  nb_choices = nb_dances = 0;
+  if (max_sol == 0) return res;
+  if (multiplicities_)
+    count_mcc(max_sol, res);
+  else
+    count_internal(heur, max_sol, res);
+  return res;
+}
+template <typename Heur>
+void DLXMatrix::count_internal(Heur &heur, count_t max_sol, count_t &count) {
+  if (!is_primary(master()->right)) {
+    count++;
+    return;
+  }
+  if (nb_active_cols_ <= kernel_threshold_) {
+    count_kernel(max_sol, count);
+    return;
+  }
+
+  Header *choice = heur(*this);
+  if (choice->size == 0) return;
+
+  cover(choice);
+  for (Node *row = choice->node.down; row != &choice->node; row = row->down) {
+    choose(row);
+    count_internal(heur, max_sol, count);
+    unchoose(row);
+    if (count >= max_sol) break;
+  }
+  uncover(choice);
+}
+
+// Calls visit on a SolutionView for each of the next solutions, without any
+// allocation. The search stops when visit returns false (if it returns a
+// bool) and can be resumed later. Returns the number of visited solutions.
+template <typename Visitor>
+size_t DLXMatrix::search_visit(Visitor &&visit) {
+  size_t res = 0;
+  while (search_iter()) {
+    res++;
+    if constexpr (std::is_void_v<std::invoke_result_t<Visitor &,
+                                                      SolutionView>>) {
+      visit(solution_view());
+    } else {
+      if (!visit(solution_view())) break;
+    }
+  }
+  return res;
+}
+
 // Concept check
 static_assert(std::is_move_constructible<DLXMatrix>::value,
               "DLXMatrix should be move constructible");
@@ -158,11 +793,226 @@ static_assert(std::is_move_assignable<DLXMatrix>::value,
               "DLXMatrix should bt move assignable");
 
 /////////////////
-template <typename Item, typename OptId, typename ItemHash = std::hash<Item>>
+// Two phases construction of a DLXMatrix: the rows are first collected in
+// compressed sparse row arrays, then finalize checks them all at once and
+// links them in a single block of nodes, with two sequential passes instead
+// of a heap allocation and a walk to the end of the columns for each row.
+// This is the way to go for large matrices.
+class DLXMatrixBuilder {
+ public:
+  using ind_t = DLXMatrix::ind_t;
+  using Vect1D = DLXMatrix::Vect1D;
+
+ private:
+  ind_t nb_col_, nb_primary_;
+  Vect1D row_start_;  // row i is cols_[row_start_[i] .. row_start_[i + 1]]
+  Vect1D cols_;
+  Vect1D colors_;  // empty as long as all the colors are 0
+
+ public:
+  explicit DLXMatrixBuilder(ind_t nb_col) : DLXMatrixBuilder(nb_col, nb_col) {}
+  DLXMatrixBuilder(ind_t nb_col, ind_t nb_primary)
+      : nb_col_(nb_col), nb_primary_(std::min(nb_col, nb_primary)),
+        row_start_{0} {}
+
+  size_t nb_cols() const { return nb_col_; }
+  size_t nb_primary() const { return nb_primary_; }
+  size_t nb_rows() const { return row_start_.size() - 1; }
+  size_t nb_entries() const { return cols_.size(); }
+  // Hints on the final sizes, to avoid reallocations
+  void reserve(size_t nb_rows, size_t nb_entries);
+
+  // A row is either given at once or item by item, closing it with end_row.
+  // Rows are only checked by finalize.
+  ind_t add_row(const Vect1D &r);
+  ind_t add_row(const Vect1D &r, const Vect1D &colors);
+  void add_item(ind_t col, ind_t color = 0) {
+    cols_.push_back(col);
+    if (color != 0 || !colors_.empty()) {
+      colors_.resize(cols_.size() - 1);
+      colors_.push_back(color);
+    }
+  }
+  ind_t end_row() {
+    row_start_.push_back(cols_.size());
+    return nb_rows() - 1;
+  }
+
+  // Throws if a row is empty or has an item out of range or colored
+  // wrongly. Otherwise returns the matrix and leaves the builder empty.
+  DLXMatrix finalize();
+  // The same on compressed sparse row arrays owned by the caller, say mapped
+  // from a file: row_start has nb_rows + 1 entries starting with 0, colors
+  // may be nullptr.
+  static DLXMatrix build(ind_t nb_col, ind_t nb_primary, size_t nb_rows,
+                         const ind_t *row_start, const ind_t *cols,
+                         const ind_t *colors = nullptr);
+};
+
+/////////////////
+// Item indexers
+//
+// A DLXMatrixIdent maps its items to its columns with an indexer, that is a
+// class with
+//   explicit Indexer(const std::vector<Item> &items);
+//   DLXMatrix::ind_t at(const Item &item) const;
+// where the constructor throws runtime_error on duplicate items and at
+// throws out_of_range on unknown ones. A hash given instead of an indexer
+// stands for HashIndexer with this hash.
+
+template <typename Item, typename Hash = std::hash<Item>>
+class HashIndexer {
+  std::unordered_map<Item, DLXMatrix::ind_t, Hash> ind_;
+
+ public:
+  explicit HashIndexer(const std::vector<Item> &items) {
+    ind_.reserve(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+      if (!ind_.emplace(items[i], i).second)
+        throw std::runtime_error("DLXMatrixIdent : Duplicate item");
+  }
+  DLXMatrix::ind_t at(const Item &item) const { return ind_.at(item); }
+};
+
+// Open addressing with linear probing in a single table
+template <typename Item, typename Hash = std::hash<Item>>
+class FlatHashIndexer {
+  std::vector<Item> items_;
+  std::vector<DLXMatrix::ind_t> slots_;  // item index + 1, 0 if empty
+  unsigned shift_;
+  Hash hash_;
+
+  // The slot of item, or the empty slot where it would go
+  size_t slot(const Item &item) const {
+    // Fibonacci hashing spreads the hashes which are the identity
+    size_t s = (uint64_t(hash_(item)) * 0x9E3779B97F4A7C15ull) >> shift_;
+    while (slots_[s] != 0 && !(items_[slots_[s] - 1] == item))
+      s = (s + 1) & (slots_.size() - 1);
+    return s;
+  }
+
+ public:
+  explicit FlatHashIndexer(const std::vector<Item> &items) : items_(items) {
+    size_t size = 16;
+    for (shift_ = 60; size < 2 * items.size(); shift_--) size *= 2;
+    slots_.assign(size, 0);
+    for (size_t i = 0; i < items_.size(); i++) {
+      size_t s = slot(items_[i]);
+      if (slots_[s] != 0)
+        throw std::runtime_error("DLXMatrixIdent : Duplicate item");
+      slots_[s] = i + 1;
+    }
+  }
+  DLXMatrix::ind_t at(const Item &item) const {
+    size_t s = slot(item);
+    if (slots_[s] == 0) throw std::out_of_range("FlatHashIndexer : no item");
+    return slots_[s] - 1;
+  }
+};
+
+// Items which are integers or tuples of integers over small ranges, as
+// ('r', row, nb) in a sudoku. The columns are stored in a dense table over
+// the box of the items and are computed from the components, without any
+// hashing. Throws if the table is much larger than the number of items.
+template <typename Item>
+class RangeIndexer {
+  static constexpr size_t arity() {
+    if constexpr (std::is_integral_v<Item>)
+      return 1;
+    else
+      return std::tuple_size<Item>::value;
+  }
+  using Coords = std::array<long long, arity()>;
+  static constexpr size_t max_table_ratio = 64;
+
+  Coords lo_, len_;
+  std::vector<DLXMatrix::ind_t> table_;  // item index + 1, 0 if none
+
+  static Coords coords(const Item &item) {
+    if constexpr (std::is_integral_v<Item>) {
+      return {static_cast<long long>(item)};
+    } else {
+      return std::apply(
+          [](auto... c) { return Coords{static_cast<long long>(c)...}; },
+          item);
+    }
+  }
+  bool position(const Item &item, size_t &pos) const {
+    Coords c = coords(item);
+    pos = 0;
+    for (size_t i = 0; i < arity(); i++) {
+      long long d = c[i] - lo_[i];
+      if (d < 0 || d >= len_[i]) return false;
+      pos = pos * len_[i] + d;
+    }
+    return true;
+  }
+
+ public:
+  explicit RangeIndexer(const std::vector<Item> &items) {
+    lo_.fill(0);
+    len_.fill(0);
+    if (items.empty()) return;
+    Coords hi = lo_ = coords(items[0]);
+    for (const Item &item : items) {
+      Coords c = coords(item);
+      for (size_t i = 0; i < arity(); i++) {
+        lo_[i] = std::min(lo_[i], c[i]);
+        hi[i] = std::max(hi[i], c[i]);
+      }
+    }
+    const size_t max_size =
+        std::max<size_t>(1024, max_table_ratio * items.size());
+    size_t size = 1;
+    for (size_t i = 0; i < arity(); i++) {
+      len_[i] = hi[i] - lo_[i] + 1;
+      if (size_t(len_[i]) > max_size / size)
+        throw std::runtime_error("DLXMatrixIdent : item ranges too large");
+      size *= len_[i];
+    }
+    table_.assign(size, 0);
+    for (size_t i = 0; i < items.size(); i++) {
+      size_t pos;
+      position(items[i], pos);
+      if (table_[pos] != 0)
+        throw std::runtime_error("DLXMatrixIdent : Duplicate item");
+      table_[pos] = i + 1;
+    }
+  }
+  DLXMatrix::ind_t at(const Item &item) const {
+    size_t pos;
+    if (!position(item, pos) || table_[pos] == 0)
+      throw std::out_of_range("RangeIndexer : no item");
+    return table_[pos] - 1;
+  }
+};
+
+namespace details {
+
+template <typename Item, typename Index, typename = void>
+struct item_indexer {
+  using type = HashIndexer<Item, Index>;
+};
+template <typename Item, typename Index>
+struct item_indexer<Item, Index,
+                    std::void_t<decltype(std::declval<const Index &>().at(
+                        std::declval<const Item &>()))>> {
+  using type = Index;
+};
+
+}  // namespace details
+
+/////////////////
+// ItemIndex is an item indexer or a hash of the items (see above)
+template <typename Item, typename OptId, typename ItemIndex = std::hash<Item>,
+          typename OptHash = std::hash<OptId>>
 class DLXMatrixIdent : private DLXMatrix {
   std::vector<Item> items_;
   std::vector<OptId> optids_;
-  std::unordered_map<Item, int, ItemHash> item_ind_;
+  typename details::item_indexer<Item, ItemIndex>::type item_ind_;
+  // The first option of each id
+  std::unordered_map<OptId, DLXMatrix::ind_t, OptHash> opt_ind_;
+  DLXMatrix::Vect1D row_;  // reused by add_opt
 
  public:
   using DLXMatrix::Vect1D, DLXMatrix::Vect2D;
@@ -182,13 +1032,7 @@ class DLXMatrixIdent : private DLXMatrix {
       : DLXMatrix(items.size(), nb_primary),
         items_(std::move(items)),
         optids_(),
-        item_ind_() {
-    for (size_t i = 0; i < items_.size(); i++) {
-      bool res;
-      std::tie(std::ignore, res) = item_ind_.insert({items_[i], i});
-      if (!res) throw std::runtime_error("DLXMatrixIdent : Duplicate item");
-    }
-  }
+        item_ind_(items_) {}
   // template <typename... Args>
   // DLXMatrixIdent(Args&&... args, const OptPairs &opts)
   //     : DLXMatrixIdent(std::forward<Args>(args)...) {
@@ -202,7 +1046,28 @@ class DLXMatrixIdent : private DLXMatrix {
       : DLXMatrixIdent(Option(items), nb_primary, opts) {}
   DLXMatrixIdent(Option &&items, ind_t nb_primary, const OptPairs &opts)
       : DLXMatrixIdent(std::move(items), nb_primary) {
-    for (const auto &[id, row] : opts) add_opt(id, row);
+    DLXMatrixBuilder builder(nb_items(), nb_primary);
+    size_t nb_entries = 0;
+    for (const auto &opt : opts) nb_entries += opt.second.size();
+    builder.reserve(opts.size(), nb_entries);
+    optids_.reserve(opts.size());
+    for (const auto &[id, row] : opts) {
+      for (const Item &item : row) builder.add_item(item_ind_.at(item));
+      opt_ind_.emplace(id, builder.end_row());
+      optids_.push_back(id);
+    }
+    DLXMatrix::operator=(builder.finalize());
+  }
+  // Names the columns and the rows of M
+  DLXMatrixIdent(Option &&items, std::vector<OptId> &&optids, DLXMatrix &&M)
+      : DLXMatrix(std::move(M)),
+        items_(std::move(items)),
+        optids_(std::move(optids)),
+        item_ind_(items_) {
+    if (items_.size() != nb_cols() || optids_.size() != nb_rows())
+      throw std::runtime_error("DLXMatrixIdent : size mismatch");
+    opt_ind_.reserve(optids_.size());
+    for (ind_t i = 0; i < optids_.size(); i++) opt_ind_.emplace(optids_[i], i);
   }
   DLXMatrixIdent(const DLXMatrixIdent &) = default;
   DLXMatrixIdent &operator=(const DLXMatrixIdent &other) = default;
@@ -211,43 +1076,92 @@ class DLXMatrixIdent : private DLXMatrix {
   ~DLXMatrixIdent() = default;
 
   using DLXMatrix::nb_choices, DLXMatrix::nb_dances;
+  using DLXMatrix::count_t;
+  using DLXMatrix::count_solutions, DLXMatrix::count_up_to;
   size_t nb_items() const { return nb_cols(); }
   size_t nb_opts() const { return nb_rows(); }
+  const std::vector<Item> &items() const { return items_; }
+  const std::vector<OptId> &opt_ids() const { return optids_; }
   using DLXMatrix::check_sizes;
   using DLXMatrix::nb_primary;
 
-  using DLXMatrix::reset;
+  using DLXMatrix::reset, DLXMatrix::depth;
   using DLXMatrix::to_string;
 
   ind_t add_opt(const OptId &optid, const Option &opt) {
+    row_.clear();
+    for (const Item &item : opt) row_.push_back(item_ind_.at(item));
+    ind_t res = DLXMatrix::add_row_sparse(row_);
+    optids_.push_back(optid);
+    opt_ind_.emplace(optid, res);
+    return res;
+  }
+  ind_t add_opt(const OptId &optid, const Option &opt, const Vect1D &colors) {
+    row_.clear();
+    for (const Item &item : opt) row_.push_back(item_ind_.at(item));
+    ind_t res = DLXMatrix::add_row_sparse(row_, colors);
     optids_.push_back(optid);
-    return DLXMatrix::add_row_sparse(details::vector_transform(
-        opt, [this](const Item &n) -> ind_t { return item_ind_.at(n); }));
+    opt_ind_.emplace(optid, res);
+    return res;
   }
   using DLXMatrix::ith_row_sparse, DLXMatrix::ith_row_dense;
+  using DLXMatrix::ith_row_colors, DLXMatrix::has_colors;
   Option ith_opt(ind_t i) const {
     return details::vector_transform(ith_row_sparse(i),
                                      [this](ind_t n) { return items_[n]; });
   }
   ind_t get_opt_ind(const OptId &opt) const {
-    auto pos = std::find(optids_.cbegin(), optids_.cend(), opt);
-    if (pos == optids_.cend())
+    auto pos = opt_ind_.find(opt);
+    if (pos == opt_ind_.end())
       throw std::runtime_error("get_opt_ind: not found");
-    return std::distance(optids_.cbegin(), pos);
+    return pos->second;
   }
 
   ind_t choose(const OptId &opt) { return DLXMatrix::choose(get_opt_ind(opt)); }
+  // Choose all the options of the range in turn. If one of them is no more
+  // active, the choices are undone with reset and false is returned.
+  template <typename Range>
+  bool choose_all(const Range &opts) {
+    const size_t depth = DLXMatrix::depth();
+    for (const OptId &opt : opts) {
+      ind_t i = get_opt_ind(opt);
+      if (!is_row_active(i)) {
+        DLXMatrix::reset(depth);
+        return false;
+      }
+      DLXMatrix::choose(i);
+    }
+    return true;
+  }
   bool is_item_active(const Item &i) const {
-    return is_row_active(items_[item_ind_.at(i)]);
+    return is_col_active(item_ind_.at(i));
+  }
+  bool is_opt_active(const OptId &i) const {
+    return is_row_active(get_opt_ind(i));
   }
-  bool is_opt_active(const OptId &i) const { return is_col_active(ith_opt(i)); }
 
   bool search_iter() { return DLXMatrix::search_iter(); }
+  using DLXMatrix::search_step;
+  using DLXMatrix::count_step;
+  using DLXMatrix::SearchLimits;
+  // The visitor gets the option indices, see get_opt_id
+  using DLXMatrix::search_visit, DLXMatrix::SolutionView;
+  const OptId &get_opt_id(ind_t i) const { return optids_.at(i); }
+  // The underlying matrix, whose rows are the option indices
+  const DLXMatrix &matrix() const { return *this; }
   std::vector<OptId> get_solution() {
     return details::vector_transform(DLXMatrix::get_solution(),
                             [this](ind_t n) { return optids_[n]; });
   }
 
+  bool search_random(std::vector<OptId> &sol) {
+    Vect1D rows;
+    if (!DLXMatrix::search_random(rows)) return false;
+    sol = details::vector_transform(rows,
+                                    [this](ind_t n) { return optids_[n]; });
+    return true;
+  }
+
   bool is_solution(const std::vector<OptId> &sol) {
     return DLXMatrix::is_solution(details::vector_transform(
         sol, [this](const OptId &opt) { return get_opt_ind(opt); }));
@@ -256,21 +1170,84 @@ class DLXMatrixIdent : private DLXMatrix {
 
 using DLXMatrixNamed = DLXMatrixIdent<std::string, std::string>;
 
+/////////////////
+// Resumable search on a DLXMatrix or a DLXMatrixIdent, which owns its matrix.
+// resume(budget) runs the search for at most budget choices and stops at the
+// next solution; many searches can thus be interleaved on a single thread.
+// A DLXSearch is also an input range of the solutions.
+template <typename Matrix>
+class DLXSearch {
+  Matrix M_;
+  SearchStatus status_;
+
+ public:
+  using Solution = decltype(std::declval<Matrix &>().get_solution());
+
+  explicit DLXSearch(Matrix M)
+      : M_(std::move(M)), status_(SearchStatus::suspended) {}
+
+  SearchStatus resume(
+      unsigned long budget = std::numeric_limits<unsigned long>::max()) {
+    if (status_ != SearchStatus::finished) status_ = M_.search_step(budget);
+    return status_;
+  }
+  SearchStatus resume(const DLXMatrix::SearchLimits &limits) {
+    if (status_ != SearchStatus::finished) status_ = M_.search_step(limits);
+    return status_;
+  }
+  SearchStatus status() const { return status_; }
+  bool done() const { return status_ == SearchStatus::finished; }
+  Solution solution() { return M_.get_solution(); }
+  Matrix &matrix() { return M_; }
+  const Matrix &matrix() const { return M_; }
+
+  class iterator {
+    DLXSearch *search_;  // nullptr at the end
+
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Solution;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Solution;
+    explicit iterator(DLXSearch *search) : search_(search) {
+      if (search_ && search_->resume() != SearchStatus::solution)
+        search_ = nullptr;
+    }
+    Solution operator*() const { return search_->solution(); }
+    iterator &operator++() {
+      if (search_->resume() != SearchStatus::solution) search_ = nullptr;
+      return *this;
+    }
+    bool operator==(const iterator &other) const {
+      return search_ == other.search_;
+    }
+    bool operator!=(const iterator &other) const {
+      return search_ != other.search_;
+    }
+  };
+  // Solutions already reported are not reported again by begin()
+  iterator begin() { return iterator(this); }
+  iterator end() { return iterator(nullptr); }
+};
+
 
 ///////////////////////////////////////////////////////////
 // Various related functions
 std::vector<DLXMatrix::ind_t> inverse_perm(
     const std::vector<DLXMatrix::ind_t> &perm);
+std::string count_to_string(DLXMatrix::count_t count);
+DLXMatrix::count_t count_from_string(const std::string &str);
 
 inline std::ostream &operator<<(std::ostream &out,
                                 const DLX_backtrack::DLXMatrix &M) {
   return out << M.to_string();
 }
 
-template <typename Item, typename OptId, typename ItemHash>
+template <typename Item, typename OptId, typename ItemIndex, typename OptHash>
 inline std::ostream &operator<<(
     std::ostream &out,
-    const DLX_backtrack::DLXMatrixIdent<Item, OptId, ItemHash> &M) {
+    const DLX_backtrack::DLXMatrixIdent<Item, OptId, ItemIndex, OptHash> &M) {
   return out << M.to_string();
 }
 
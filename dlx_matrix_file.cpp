@@ -0,0 +1,397 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Binary files of matrices
+///////////////////////////
+#include "dlx_matrix_file.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close
+
+#include <cstdio>     // remove
+#include <cstdlib>    // mkstemp
+#include <cstring>    // memcmp, memcpy
+#include <fstream>    // ofstream
+#include <sstream>    // ostringstream
+#include <stdexcept>  // out_of_range, runtime_error
+#include <string>     // string
+#include <vector>     // vector
+
+namespace DLX_backtrack {
+
+//////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_matrix_file]Binary files");
+//////////////////////////////////////////////////////
+
+using Vect1D = DLXMatrix::Vect1D;
+using Vect2D = DLXMatrix::Vect2D;
+using ind_t = DLXMatrix::ind_t;
+
+// The arrays of the file are handed as they are to DLXMatrixBuilder
+static_assert(sizeof(ind_t) == sizeof(uint64_t),
+              "MatrixFile : the indices should be 64 bits words");
+
+static constexpr char magic[8] = {'D', 'L', 'X', 'M', 'A', 'T', 'R', 'X'};
+static constexpr size_t header_size = 8;  // in words
+
+// A fresh temporary file, removed with the object
+class TempFile {
+  std::string name_;
+
+ public:
+  TempFile() {
+    char name[] = "/tmp/dlx_matrix_fileXXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0) throw std::runtime_error("cannot create a temporary file");
+    close(fd);
+    name_ = name;
+  }
+  ~TempFile() { std::remove(name_.c_str()); }
+  const std::string &name() const { return name_; }
+};
+
+static void write_words(std::ostream &out, const uint64_t *words, size_t n) {
+  out.write(reinterpret_cast<const char *>(words), n * sizeof(uint64_t));
+}
+
+static void save(std::ostream &out, const DLXMatrix &M,
+                 const std::vector<std::string> *items,
+                 const std::vector<std::string> *opts) {
+  Vect1D row_start{0}, cols, colors, mults;
+  row_start.reserve(M.nb_rows() + 1);
+  for (ind_t i = 0; i < M.nb_rows(); i++) {
+    Vect1D row = M.ith_row_sparse(i);
+    cols.insert(cols.end(), row.begin(), row.end());
+    row_start.push_back(cols.size());
+    if (M.has_colors()) {
+      Vect1D row_colors = M.ith_row_colors(i);
+      colors.insert(colors.end(), row_colors.begin(), row_colors.end());
+    }
+  }
+  if (M.has_multiplicities()) {
+    for (ind_t i = 0; i < M.nb_primary(); i++) {
+      auto [lo, hi] = M.multiplicity(i);
+      mults.push_back(lo);
+      mults.push_back(hi);
+    }
+  }
+  Vect1D name_start{0};
+  std::string names;
+  if (items) {
+    if (items->size() != M.nb_cols() || opts->size() != M.nb_rows())
+      throw std::runtime_error("MatrixFile : names size mismatch");
+    for (const auto *v : {items, opts}) {
+      for (const std::string &name : *v) {
+        names += name;
+        name_start.push_back(names.size());
+      }
+    }
+  }
+
+  uint64_t header[header_size];
+  std::memcpy(&header[0], magic, sizeof(magic));
+  header[1] = MatrixFile::version;
+  header[2] = (M.has_colors() ? uint64_t(MatrixFile::has_colors) : 0) |
+              (M.has_multiplicities()
+                   ? uint64_t(MatrixFile::has_multiplicities)
+                   : 0) |
+              (items ? uint64_t(MatrixFile::has_names) : 0);
+  header[3] = M.nb_cols();
+  header[4] = M.nb_primary();
+  header[5] = M.nb_rows();
+  header[6] = cols.size();
+  header[7] = names.size();
+  write_words(out, header, header_size);
+  write_words(out, row_start.data(), row_start.size());
+  write_words(out, cols.data(), cols.size());
+  write_words(out, colors.data(), colors.size());
+  write_words(out, mults.data(), mults.size());
+  if (items) {
+    write_words(out, name_start.data(), name_start.size());
+    names.resize((names.size() + 7) / 8 * 8, '\0');
+    out.write(names.data(), names.size());
+  }
+  if (!out) throw std::runtime_error("MatrixFile : write error");
+}
+
+void save_matrix(std::ostream &out, const DLXMatrix &M) {
+  save(out, M, nullptr, nullptr);
+}
+void save_matrix(std::ostream &out, const DLXMatrix &M,
+                 const std::vector<std::string> &items,
+                 const std::vector<std::string> &opts) {
+  save(out, M, &items, &opts);
+}
+
+MatrixFile::MatrixFile(const std::string &filename)
+    : data_(nullptr),
+      size_(0),
+      colors_(nullptr),
+      mults_(nullptr),
+      name_start_(nullptr),
+      names_(nullptr) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) throw std::runtime_error("MatrixFile : cannot open " + filename);
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= 0) size_ = st.st_size;
+  if (size_ < header_size * sizeof(uint64_t)) {
+    close(fd);
+    throw std::runtime_error("MatrixFile : not a matrix file " + filename);
+  }
+  data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data_ == MAP_FAILED)
+    throw std::runtime_error("MatrixFile : cannot map " + filename);
+
+  // The file is only read through the arrays, nothing is parsed. The checks
+  // below ensure that build stays in the file: row_start goes up to
+  // nb_entries, build checks that it is increasing.
+  header_ = static_cast<const uint64_t *>(data_);
+  const uint64_t *words = header_ + header_size;
+  size_t remaining = size_ / sizeof(uint64_t) - header_size;
+  auto take = [&words, &remaining](size_t nb) {
+    if (nb > remaining) throw std::runtime_error("MatrixFile : truncated file");
+    const uint64_t *res = words;
+    words += nb;
+    remaining -= nb;
+    return res;
+  };
+  try {
+    if (std::memcmp(header_, magic, sizeof(magic)) != 0)
+      throw std::runtime_error("MatrixFile : not a matrix file " + filename);
+    if (header_[1] != version) {
+      throw std::runtime_error(__builtin_bswap64(header_[1]) == version
+                                   ? "MatrixFile : wrong byte order"
+                                   : "MatrixFile : unsupported version");
+    }
+    // The matrix has nb_cols + 1 headers, which must not wrap around
+    if (size_ % sizeof(uint64_t) != 0 || nb_primary() > nb_cols() ||
+        nb_cols() >= uint64_t(1) << 63)
+      throw std::runtime_error("MatrixFile : corrupted file");
+    if (flags() & ~uint64_t(has_colors | has_multiplicities | has_names))
+      throw std::runtime_error("MatrixFile : unknown flags");
+    if (nb_rows() >= remaining)
+      throw std::runtime_error("MatrixFile : truncated file");
+    row_start_ = take(nb_rows() + 1);
+    cols_ = take(nb_entries());
+    if (row_start_[0] != 0 || row_start_[nb_rows()] != nb_entries())
+      throw std::runtime_error("MatrixFile : corrupted file");
+    if (flags() & has_colors) colors_ = take(nb_entries());
+    if (flags() & has_multiplicities) {
+      if (nb_primary() > remaining)
+        throw std::runtime_error("MatrixFile : truncated file");
+      mults_ = take(2 * nb_primary());
+    }
+    if (flags() & has_names) {
+      // nb_cols + nb_rows + 1 must not overflow
+      if (nb_cols() >= remaining || nb_rows() >= remaining - nb_cols())
+        throw std::runtime_error("MatrixFile : truncated file");
+      const size_t nb_names = nb_cols() + nb_rows(), names_size = header_[7];
+      name_start_ = take(nb_names + 1);
+      names_ = reinterpret_cast<const char *>(
+          take(names_size / 8 + (names_size % 8 != 0)));
+      if (name_start_[0] != 0 || name_start_[nb_names] != names_size)
+        throw std::runtime_error("MatrixFile : corrupted file");
+      for (size_t i = 0; i < nb_names; i++)
+        if (name_start_[i] > name_start_[i + 1])
+          throw std::runtime_error("MatrixFile : corrupted file");
+    }
+    if (remaining != 0) throw std::runtime_error("MatrixFile : corrupted file");
+  } catch (...) {
+    munmap(data_, size_);
+    throw;
+  }
+}
+MatrixFile::~MatrixFile() { munmap(data_, size_); }
+
+std::string_view MatrixFile::item_name(ind_t i) const {
+  if (!names_) throw std::runtime_error("MatrixFile : no names");
+  if (i >= nb_cols()) throw std::out_of_range("MatrixFile : item out of range");
+  return std::string_view(names_ + name_start_[i],
+                          name_start_[i + 1] - name_start_[i]);
+}
+std::string_view MatrixFile::opt_name(ind_t i) const {
+  if (!names_) throw std::runtime_error("MatrixFile : no names");
+  if (i >= nb_rows())
+    throw std::out_of_range("MatrixFile : option out of range");
+  i += nb_cols();
+  return std::string_view(names_ + name_start_[i],
+                          name_start_[i + 1] - name_start_[i]);
+}
+
+DLXMatrix MatrixFile::matrix() const {
+  DLXMatrix res = DLXMatrixBuilder::build(nb_cols(), nb_primary(), nb_rows(),
+                                          row_start_, cols_, colors_);
+  for (ind_t i = 0; mults_ && i < nb_primary(); i++)
+    res.set_multiplicity(i, mults_[2 * i], mults_[2 * i + 1]);
+  return res;
+}
+DLXMatrixNamed MatrixFile::named_matrix() const {
+  std::vector<std::string> items, opts;
+  items.reserve(nb_cols());
+  for (ind_t i = 0; i < nb_cols(); i++) items.emplace_back(item_name(i));
+  opts.reserve(nb_rows());
+  for (ind_t i = 0; i < nb_rows(); i++) opts.emplace_back(opt_name(i));
+  return DLXMatrixNamed(std::move(items), std::move(opts), matrix());
+}
+
+TEST_CASE("Functions save_matrix and load_matrix") {
+  DLXMatrix MColor(5, 2);
+  MColor.add_row_sparse({0, 2, 3}, {0, 1, 0});
+  MColor.add_row_sparse({0, 2}, {0, 2});
+  MColor.add_row_sparse({1, 2}, {0, 1});
+  MColor.add_row_sparse({1, 4});
+  DLXMatrix MMult(3, 2, {{0}, {0, 2}, {1}, {0, 1}});
+  MMult.set_multiplicity(0, 1, 2);
+  std::vector<DLXMatrix> Sample = {
+      DLXMatrix(0), DLXMatrix(5), DLXMatrix(5, 3, {{0, 1}, {2}, {2, 3, 4}}),
+      Langford_matrix(5), Langford_matrix(8), MColor, MMult};
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    TempFile file;
+    {
+      std::ofstream out(file.name(), std::ios::binary);
+      save_matrix(out, M);
+    }
+    MatrixFile mapped(file.name());
+    CHECK(mapped.nb_cols() == M.nb_cols());
+    CHECK(mapped.nb_rows() == M.nb_rows());
+    DLXMatrix N = mapped.matrix();
+    CHECK(N.nb_cols() == M.nb_cols());
+    CHECK(N.nb_primary() == M.nb_primary());
+    REQUIRE(N.nb_rows() == M.nb_rows());
+    for (ind_t i = 0; i < M.nb_rows(); i++) {
+      CHECK(N.ith_row_sparse(i) == M.ith_row_sparse(i));
+      CHECK(N.ith_row_colors(i) == M.ith_row_colors(i));
+    }
+    CHECK(N.has_colors() == M.has_colors());
+    CHECK(N.has_multiplicities() == M.has_multiplicities());
+    CHECK(N.count_solutions() == M.count_solutions());
+    CHECK(load_matrix(file.name()).nb_rows() == M.nb_rows());
+    CHECK_THROWS_WITH_AS(mapped.item_name(0), "MatrixFile : no names",
+                         std::runtime_error);
+  }
+}
+
+TEST_CASE("Names") {
+  // clang-format off
+  DLXMatrixNamed M({"A", "B", "C", "D", ""},
+                   { {"rowAB", {"A", "B"}},
+                     {"rowAC", {"A", "C"}},
+                     {"rowCD", {"C", "D"}},
+                     {"row BD", {"B", "D", ""}} });
+  // clang-format on
+  TempFile file;
+  {
+    std::ofstream out(file.name(), std::ios::binary);
+    save_matrix(out, M);
+  }
+  MatrixFile mapped(file.name());
+  CHECK(mapped.item_name(2) == "C");
+  CHECK(mapped.item_name(4) == "");
+  CHECK(mapped.opt_name(3) == "row BD");
+  CHECK_THROWS_AS(mapped.opt_name(4), std::out_of_range);
+  DLXMatrixNamed N = mapped.named_matrix();
+  CHECK(N.items() == M.items());
+  CHECK(N.opt_ids() == M.opt_ids());
+  CHECK(N.ith_opt(3) == M.ith_opt(3));
+  REQUIRE(N.search_iter());
+  CHECK(N.is_solution({"rowAC", "row BD"}));
+  CHECK_FALSE(N.search_iter());
+
+  std::ostringstream out;
+  CHECK_THROWS_WITH_AS(save_matrix(out, M.matrix(), M.items(), {"rowAB"}),
+                       "MatrixFile : names size mismatch", std::runtime_error);
+}
+
+TEST_CASE("Bad files") {
+  CHECK_THROWS_WITH_AS(MatrixFile("/nonexistent/file"),
+                       "MatrixFile : cannot open /nonexistent/file",
+                       std::runtime_error);
+  TempFile file;
+  std::string content;
+  {
+    std::ostringstream out;
+    save_matrix(out, Langford_matrix(4));
+    content = out.str();
+  }
+  auto check_throws = [&file](const std::string &data, const char *msg) {
+    {
+      std::ofstream out(file.name(), std::ios::binary);
+      out << data;
+    }
+    CHECK_THROWS_WITH_AS(MatrixFile(file.name()), msg, std::runtime_error);
+  };
+  check_throws("DLXMATRX", ("MatrixFile : not a matrix file " +
+                            file.name()).c_str());
+  std::string bad = content;
+  bad[0] = 'd';
+  check_throws(bad, ("MatrixFile : not a matrix file " + file.name()).c_str());
+  bad = content;
+  bad[8] = 2;
+  check_throws(bad, "MatrixFile : unsupported version");
+  bad = content;
+  bad[8] = 0;
+  bad[15] = 1;
+  check_throws(bad, "MatrixFile : wrong byte order");
+  check_throws(content.substr(0, content.size() - 8),
+               "MatrixFile : truncated file");
+  check_throws(content + std::string(8, '\0'), "MatrixFile : corrupted file");
+  bad = content;
+  bad[16] |= 8;
+  check_throws(bad, "MatrixFile : unknown flags");
+  for (uint64_t nb_cols : {~uint64_t(0), uint64_t(1) << 63}) {
+    bad = content;
+    std::memcpy(&bad[3 * 8], &nb_cols, 8);
+    check_throws(bad, "MatrixFile : corrupted file");
+  }
+  {
+    // A names size of 2^64 - 1 with the names removed must not wrap around
+    std::ostringstream out;
+    save_matrix(out, DLXMatrix(2, {{0}, {1}}), {"A", "B"}, {"rowA", "rowB"});
+    bad = out.str();
+    const uint64_t names_size = ~uint64_t(0);
+    bad.resize(bad.size() - 2 * 8);  // the 10 bytes of names
+    std::memcpy(&bad[7 * 8], &names_size, 8);
+    std::memcpy(&bad[bad.size() - 8], &names_size, 8);
+    check_throws(bad, "MatrixFile : truncated file");
+    // Neither nb_cols + nb_rows
+    bad = out.str();
+    const uint64_t nb_cols = (uint64_t(1) << 63) - 1;
+    std::memcpy(&bad[3 * 8], &nb_cols, 8);
+    check_throws(bad, "MatrixFile : truncated file");
+  }
+  // An empty row: two equal row starts
+  bad = content;
+  std::memcpy(&bad[8 * header_size + 8], &bad[8 * header_size], 8);
+  {
+    std::ofstream out(file.name(), std::ios::binary);
+    out << bad;
+  }
+  MatrixFile mapped(file.name());
+  CHECK_THROWS_WITH_AS(mapped.matrix(), "DLXMatrixBuilder : empty row",
+                       std::runtime_error);
+}
+
+//////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_matrix_file]Binary files";
+//////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
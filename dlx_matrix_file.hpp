@@ -0,0 +1,107 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Binary files of matrices
+//
+// A matrix is saved as its compressed sparse rows, so that loading it is
+// mapping the file in memory and handing the arrays to
+// DLXMatrixBuilder::build, without any parsing. All the fields are 64 bits
+// words in the byte order of the machine which wrote the file:
+//
+//   "DLXMATRX" version flags nb_cols nb_primary nb_rows nb_entries names_size
+//   row_start[nb_rows + 1] cols[nb_entries]
+//   colors[nb_entries]                         if flags & has_colors
+//   (lo, hi)[nb_primary]                       if flags & has_multiplicities
+//   name_start[nb_cols + nb_rows + 1]          if flags & has_names
+//   names_size bytes, padded to a word         if flags & has_names
+//
+// where row i has the columns cols[row_start[i] .. row_start[i + 1]] and
+// the names of the items, then of the options, are the bytes
+// [name_start[i] .. name_start[i + 1]] of the names.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_MATRIX_FILE_HPP_
+#define DLX_MATRIX_FILE_HPP_
+
+#include <cstdint>      // uint64_t
+#include <iostream>     // ostream
+#include <string>       //
+#include <string_view>  // string_view
+#include <vector>       //
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+class MatrixFile {
+ public:
+  using ind_t = DLXMatrix::ind_t;
+  static constexpr uint64_t version = 1;
+  enum Flags : uint64_t {
+    has_colors = 1,
+    has_multiplicities = 2,
+    has_names = 4
+  };
+
+ private:
+  void *data_;
+  size_t size_;
+  const uint64_t *header_;
+  const ind_t *row_start_, *cols_, *colors_, *mults_, *name_start_;
+  const char *names_;
+
+ public:
+  // Maps the file, checking its header and the sizes of its sections
+  explicit MatrixFile(const std::string &filename);
+  MatrixFile(const MatrixFile &) = delete;
+  MatrixFile &operator=(const MatrixFile &) = delete;
+  ~MatrixFile();
+
+  uint64_t flags() const { return header_[2]; }
+  size_t nb_cols() const { return header_[3]; }
+  size_t nb_primary() const { return header_[4]; }
+  size_t nb_rows() const { return header_[5]; }
+  size_t nb_entries() const { return header_[6]; }
+  const ind_t *row_start() const { return row_start_; }
+  const ind_t *cols() const { return cols_; }
+  const ind_t *colors() const { return colors_; }  // nullptr if none
+
+  std::string_view item_name(ind_t i) const;
+  std::string_view opt_name(ind_t i) const;
+
+  DLXMatrix matrix() const;
+  // Throws if the file has no names
+  DLXMatrixNamed named_matrix() const;
+};
+
+// M should be at its root. The names, if any, are those of the columns and
+// of the rows.
+void save_matrix(std::ostream &out, const DLXMatrix &M);
+void save_matrix(std::ostream &out, const DLXMatrix &M,
+                 const std::vector<std::string> &items,
+                 const std::vector<std::string> &opts);
+template <typename ItemIndex, typename OptHash>
+void save_matrix(
+    std::ostream &out,
+    const DLXMatrixIdent<std::string, std::string, ItemIndex, OptHash> &M) {
+  save_matrix(out, M.matrix(), M.items(), M.opt_ids());
+}
+
+inline DLXMatrix load_matrix(const std::string &filename) {
+  return MatrixFile(filename).matrix();
+}
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_MATRIX_FILE_HPP_
@@ -0,0 +1,245 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Multithreaded work stealing search on a DLXMatrix
+/////////////////////////////////////////////////////
+#include "dlx_parallel.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <algorithm>  // min, max
+#include <atomic>     // atomic
+#include <deque>      // deque
+#include <exception>  // exception_ptr
+#include <mutex>      // mutex, lock_guard
+#include <thread>     // thread
+#include <vector>     // vector
+
+namespace DLX_backtrack {
+
+//////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_parallel]Function search_parallel");
+//////////////////////////////////////////////////////
+
+using Vect1D = DLXMatrix::Vect1D;
+using Vect2D = DLXMatrix::Vect2D;
+using ind_t = DLXMatrix::ind_t;
+
+namespace {
+
+// The owner pops subproblems from the front, the thieves from the back.
+class WorkQueue {
+  std::mutex mutex_;
+  std::deque<size_t> tasks_;
+
+ public:
+  void push(size_t task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(task);
+  }
+  bool pop(size_t &task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) return false;
+    task = tasks_.front();
+    tasks_.pop_front();
+    return true;
+  }
+  bool steal(size_t &task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (tasks_.empty()) return false;
+    task = tasks_.back();
+    tasks_.pop_back();
+    return true;
+  }
+};
+
+struct TaskResult {
+  Vect2D solutions;
+  DLXMatrix::count_t nb_solutions = 0;
+  bool done = false;
+};
+
+}  // namespace
+
+ParallelResult search_parallel(const DLXMatrix &M,
+                               const ParallelOptions &opts) {
+  ParallelResult res;
+  DLXMatrix split(M);
+  const Vect2D subs = split.subproblems(opts.split_depth);
+  res.nb_subproblems = subs.size();
+  res.nb_choices = split.nb_choices;
+  res.nb_dances = split.nb_dances;
+  if (subs.empty() || opts.max_sol == 0) return res;
+
+  size_t nb_threads = opts.nb_threads;
+  if (nb_threads == 0) nb_threads = std::thread::hardware_concurrency();
+  nb_threads = std::max<size_t>(1, std::min(nb_threads, subs.size()));
+
+  // Contiguous blocks of subproblems share most of their choices, the
+  // workers start on their own block and steal from the others' end.
+  std::vector<WorkQueue> queues(nb_threads);
+  for (size_t i = 0; i < subs.size(); i++)
+    queues[i * nb_threads / subs.size()].push(i);
+
+  std::vector<TaskResult> results(subs.size());
+  std::vector<unsigned long> choices(nb_threads, 0), dances(nb_threads, 0);
+  std::vector<std::exception_ptr> errors(nb_threads);
+  // Subproblems from cutoff on are no longer needed
+  std::atomic<size_t> cutoff(subs.size());
+  std::mutex done_mutex;
+  size_t done_prefix = 0;
+  DLXMatrix::count_t total = 0, done_count = 0;
+
+  auto record = [&](size_t task) {
+    if (opts.max_sol == std::numeric_limits<size_t>::max()) return;
+    if (!opts.ordered) {
+      std::lock_guard<std::mutex> lock(done_mutex);
+      total += results[task].nb_solutions;
+      if (total >= opts.max_sol) cutoff = 0;
+      return;
+    }
+    // The first max_sol solutions are known once all the subproblems before
+    // them are done.
+    std::lock_guard<std::mutex> lock(done_mutex);
+    results[task].done = true;
+    while (done_prefix < subs.size() && results[done_prefix].done) {
+      done_count += results[done_prefix++].nb_solutions;
+      if (done_count >= opts.max_sol) {
+        cutoff = done_prefix;
+        break;
+      }
+    }
+  };
+
+  auto worker = [&](size_t w) {
+    try {
+      DLXMatrix W(M);
+      const size_t base = W.depth();
+      W.reset(base);
+      size_t task;
+      for (;;) {
+        bool found = queues[w].pop(task);
+        for (size_t i = 1; !found && i < nb_threads; i++)
+          found = queues[(w + i) % nb_threads].steal(task);
+        if (!found) break;
+        if (task >= cutoff) continue;
+
+        for (ind_t r : subs[task]) W.choose(r);
+        W.reset(W.depth());
+        TaskResult &tres = results[task];
+        if (opts.count_only) {
+          tres.nb_solutions = W.count_up_to(opts.max_sol);
+        } else {
+          tres.solutions = W.search_rec(opts.max_sol);
+          tres.nb_solutions = tres.solutions.size();
+        }
+        choices[w] += W.nb_choices;
+        dances[w] += W.nb_dances;
+        W.reset(base);
+        record(task);
+      }
+    } catch (...) {
+      errors[w] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t w = 1; w < nb_threads; w++) threads.emplace_back(worker, w);
+  worker(0);
+  for (auto &t : threads) t.join();
+  for (auto &e : errors)
+    if (e) std::rethrow_exception(e);
+
+  for (size_t w = 0; w < nb_threads; w++) {
+    res.nb_choices += choices[w];
+    res.nb_dances += dances[w];
+  }
+  for (auto &tres : results) {
+    if (res.nb_solutions >= opts.max_sol) break;
+    res.nb_solutions += tres.nb_solutions;
+    for (auto &s : tres.solutions) res.solutions.push_back(std::move(s));
+  }
+  if (res.nb_solutions > opts.max_sol) res.nb_solutions = opts.max_sol;
+  if (res.solutions.size() > opts.max_sol) res.solutions.resize(opts.max_sol);
+  return res;
+}
+TEST_CASE_FIXTURE(DLXTestFixture, "Function search_parallel") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.insert(Sample.end(), LangfordSample.begin(), LangfordSample.end());
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    Vect2D expected = M.search_rec();
+    for (size_t nb_threads : {1, 2, 4}) {
+      for (size_t depth : {0, 1, 3}) {
+        CAPTURE(nb_threads);
+        CAPTURE(depth);
+        ParallelOptions opts;
+        opts.nb_threads = nb_threads;
+        opts.split_depth = depth;
+        ParallelResult res = search_parallel(M, opts);
+        CHECK(res.solutions == expected);
+        CHECK(res.nb_solutions == expected.size());
+        CHECK(res.nb_choices == M.nb_choices);
+        CHECK(res.nb_dances == M.nb_dances);
+
+        opts.count_only = true;
+        res = search_parallel(M, opts);
+        CHECK(res.solutions.empty());
+        CHECK(res.nb_solutions == expected.size());
+        CHECK(res.nb_choices == M.nb_choices);
+      }
+    }
+  }
+}
+TEST_CASE("Function search_parallel max_sol") {
+  DLXMatrix M = Langford_matrix(8);
+  Vect2D expected = M.search_rec();
+  ParallelOptions opts;
+  opts.nb_threads = 4;
+  opts.max_sol = 17;
+  ParallelResult res = search_parallel(M, opts);
+  CHECK(res.solutions == Vect2D(expected.begin(), expected.begin() + 17));
+  CHECK(res.nb_solutions == 17);
+  opts.count_only = true;
+  CHECK(search_parallel(M, opts).nb_solutions == 17);
+
+  opts.count_only = false;
+  opts.ordered = false;
+  res = search_parallel(M, opts);
+  CHECK(res.solutions.size() == 17);
+  for (const Vect1D &s : res.solutions) CHECK(M.is_solution(s));
+
+  opts.max_sol = 0;
+  CHECK(search_parallel(M, opts).nb_solutions == 0);
+}
+TEST_CASE("Function search_parallel after choose") {
+  DLXMatrix M = Langford_matrix(8);
+  M.choose(3);
+  M.choose(30);
+  ParallelOptions opts;
+  opts.nb_threads = 3;
+  ParallelResult res = search_parallel(M, opts);
+  CHECK(M.depth() == 2);
+  Vect2D expected = M.search_rec();
+  CHECK(res.solutions == expected);
+  CHECK(res.nb_choices == M.nb_choices);
+}
+
+//////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_parallel]Function search_parallel";
+//////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
@@ -0,0 +1,57 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Multithreaded search on a DLXMatrix
+//
+// The search tree is split at a given depth into subproblems (see
+// DLXMatrix::subproblems). Each worker thread owns a copy of the matrix and
+// a deque of subproblems; a worker whose deque is empty steals subproblems
+// from the back of the deques of the others. Replaying a subproblem is a
+// sequence of choose, so the worker copies never need to be rebuilt.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_PARALLEL_HPP_
+#define DLX_PARALLEL_HPP_
+
+#include <limits>  // numeric_limits
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+struct ParallelOptions {
+  size_t nb_threads = 0;   // 0 means std::thread::hardware_concurrency()
+  size_t split_depth = 3;  // depth of the subproblems
+  bool ordered = true;     // return the solutions in sequential order
+  bool count_only = false;  // only count the solutions, don't store them
+  size_t max_sol = std::numeric_limits<size_t>::max();
+};
+
+struct ParallelResult {
+  DLXMatrix::Vect2D solutions;
+  DLXMatrix::count_t nb_solutions = 0;
+  size_t nb_subproblems = 0;
+  // Summed over the splitting and all the workers
+  unsigned long int nb_choices = 0, nb_dances = 0;
+};
+
+// Search the solutions of M below its current choices, M is left untouched.
+// When opts.ordered is set and max_sol is not reached, the solutions and the
+// statistics are the same as the ones of M.search_rec().
+ParallelResult search_parallel(const DLXMatrix &M,
+                               const ParallelOptions &opts = {});
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_PARALLEL_HPP_
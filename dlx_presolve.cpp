@@ -0,0 +1,379 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Shrinking an exact cover problem before the search
+/////////////////////////////////////////////////////
+#include "dlx_presolve.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <algorithm>  // sort, lower_bound, includes
+#include <map>        // map
+#include <stdexcept>  // runtime_error
+#include <vector>     // vector
+
+namespace DLX_backtrack {
+
+//////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_presolve]Presolve");
+//////////////////////////////////////////////////////
+
+using Vect1D = DLXMatrix::Vect1D;
+using Vect2D = DLXMatrix::Vect2D;
+using ind_t = DLXMatrix::ind_t;
+using count_t = DLXMatrix::count_t;
+
+class DLXPresolveFixture : public DLXTestFixture {
+ public:
+  DLXPresolveFixture() {
+    // Duplicate rows
+    TestSample.push_back(
+        DLXMatrix(4, {{0, 1}, {2, 3}, {0, 1}, {2, 3}, {0, 2}}));
+    TestSample.push_back(Langford_matrix(4));
+    TestSample.push_back(Langford_matrix(7));
+  }
+};
+
+namespace {
+
+// The state of the reduction: the rows still alive and the columns covered
+// by the forced rows. Each column keeps the list of all its rows, dead or
+// alive, together with the number of alive ones.
+class Reducer {
+ public:
+  explicit Reducer(const DLXMatrix &M);
+  void force(ind_t r);
+  void remove_no_primary();
+  void merge_duplicates();
+  void remove_dominated();
+  bool force_singles();
+  bool remove_conflicting();
+  Presolved result() const;
+
+  bool feasible = true;
+
+ private:
+  void kill(ind_t r);
+
+  ind_t nb_primary_;
+  Vect2D rows_, alts_, col_rows_, forced_;
+  std::vector<bool> alive_, covered_;
+  Vect1D col_size_;
+  // Scratch for remove_conflicting
+  std::vector<size_t> mark_, seen_;
+  Vect1D count_;
+  size_t stamp_ = 0;
+};
+
+Reducer::Reducer(const DLXMatrix &M)
+    : nb_primary_(M.nb_primary()), rows_(M.nb_rows()), alts_(M.nb_rows()),
+      col_rows_(M.nb_cols()), alive_(M.nb_rows(), true),
+      covered_(M.nb_cols(), false), col_size_(M.nb_cols(), 0),
+      mark_(M.nb_cols(), 0), seen_(M.nb_rows(), 0), count_(M.nb_cols(), 0) {
+  if (M.has_colors() || M.has_multiplicities())
+    throw std::runtime_error(
+        "Presolve : colors and multiplicities are not supported");
+  for (ind_t r = 0; r < M.nb_rows(); r++) {
+    rows_[r] = M.ith_row_sparse(r);
+    std::sort(rows_[r].begin(), rows_[r].end());
+    alts_[r] = {r};
+    for (ind_t c : rows_[r]) {
+      col_rows_[c].push_back(r);
+      col_size_[c]++;
+    }
+  }
+}
+
+void Reducer::kill(ind_t r) {
+  if (!alive_[r]) return;
+  alive_[r] = false;
+  for (ind_t c : rows_[r]) col_size_[c]--;
+}
+
+void Reducer::force(ind_t r) {
+  if (!alive_[r]) {
+    feasible = false;
+    return;
+  }
+  forced_.push_back(alts_[r]);
+  for (ind_t c : rows_[r]) {
+    covered_[c] = true;
+    for (ind_t r1 : col_rows_[c]) kill(r1);
+  }
+}
+
+// The search never chooses a row without primary column
+void Reducer::remove_no_primary() {
+  for (ind_t r = 0; r < rows_.size(); r++)
+    if (rows_[r].empty() || rows_[r].front() >= nb_primary_) kill(r);
+}
+
+void Reducer::merge_duplicates() {
+  std::map<Vect1D, ind_t> first;
+  for (ind_t r = 0; r < rows_.size(); r++) {
+    if (!alive_[r]) continue;
+    auto [it, inserted] = first.emplace(rows_[r], r);
+    if (!inserted) {
+      Vect1D &alts = alts_[it->second];
+      alts.insert(alts.end(), alts_[r].begin(), alts_[r].end());
+      kill(r);
+    }
+  }
+}
+
+// A row with the same primary columns as another one and more secondary
+// columns can be replaced by the other one in any solution.
+void Reducer::remove_dominated() {
+  std::map<Vect1D, Vect1D> groups;
+  for (ind_t r = 0; r < rows_.size(); r++) {
+    if (!alive_[r]) continue;
+    auto sec = std::lower_bound(rows_[r].begin(), rows_[r].end(), nb_primary_);
+    groups[Vect1D(rows_[r].begin(), sec)].push_back(r);
+  }
+  auto secondary = [this](ind_t r) {
+    return std::lower_bound(rows_[r].begin(), rows_[r].end(), nb_primary_);
+  };
+  for (const auto &group : groups) {
+    const Vect1D &rs = group.second;
+    for (ind_t a : rs) {
+      if (!alive_[a]) continue;
+      for (ind_t b : rs) {
+        if (a == b || !alive_[b]) continue;
+        if (std::includes(secondary(b), rows_[b].end(), secondary(a),
+                          rows_[a].end()))
+          kill(b);
+      }
+    }
+  }
+}
+
+bool Reducer::force_singles() {
+  bool changed = false;
+  for (ind_t c = 0; c < nb_primary_ && feasible; c++) {
+    if (covered_[c]) continue;
+    if (col_size_[c] == 0) {
+      feasible = false;
+    } else if (col_size_[c] == 1) {
+      for (ind_t r : col_rows_[c])
+        if (alive_[r]) {
+          force(r);
+          break;
+        }
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// Removes the rows r such that every row of some primary column c shares a
+// column with r. The rows sharing a column with r are counted in each of
+// their columns; c is such a column if its count is its size.
+bool Reducer::remove_conflicting() {
+  bool changed = false;
+  Vect1D touched;
+  for (ind_t r = 0; r < rows_.size(); r++) {
+    if (!alive_[r]) continue;
+    stamp_++;
+    for (ind_t c : rows_[r]) mark_[c] = stamp_;
+    touched.clear();
+    for (ind_t c : rows_[r]) {
+      for (ind_t r1 : col_rows_[c]) {
+        if (!alive_[r1] || r1 == r || seen_[r1] == stamp_) continue;
+        seen_[r1] = stamp_;
+        for (ind_t c1 : rows_[r1]) {
+          if (mark_[c1] == stamp_) continue;
+          if (count_[c1]++ == 0) touched.push_back(c1);
+        }
+      }
+    }
+    bool conflict = false;
+    for (ind_t c1 : touched) {
+      if (c1 < nb_primary_ && count_[c1] == col_size_[c1]) conflict = true;
+      count_[c1] = 0;
+    }
+    if (conflict) {
+      kill(r);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+Presolved Reducer::result() const {
+  Presolved res;
+  if (!feasible) {
+    res.matrix = DLXMatrix(1);
+    res.feasible = false;
+    return res;
+  }
+  res.forced = forced_;
+  Vect1D new_col(col_size_.size());
+  ind_t nb_primary = 0;
+  for (ind_t c = 0; c < col_size_.size(); c++) {
+    if (covered_[c] || (c >= nb_primary_ && col_size_[c] == 0)) continue;
+    if (c < nb_primary_) nb_primary++;
+    new_col[c] = res.col_map.size();
+    res.col_map.push_back(c);
+  }
+  Vect2D rows;
+  for (ind_t r = 0; r < rows_.size(); r++) {
+    if (!alive_[r]) continue;
+    Vect1D row;
+    for (ind_t c : rows_[r]) row.push_back(new_col[c]);
+    rows.push_back(row);
+    res.row_map.push_back(alts_[r]);
+  }
+  res.matrix = DLXMatrix(res.col_map.size(), nb_primary, rows);
+  return res;
+}
+
+}  // namespace
+
+Presolved presolve(const DLXMatrix &M, const Vect1D &chosen,
+                   bool all_solutions) {
+  Reducer red(M);
+  for (ind_t r : chosen) {
+    if (r >= M.nb_rows()) throw std::runtime_error("Presolve : bad row");
+    red.force(r);
+  }
+  red.remove_no_primary();
+  red.merge_duplicates();
+  if (!all_solutions) red.remove_dominated();
+  bool changed = true;
+  while (red.feasible && changed) {
+    changed = red.force_singles();
+    if (red.feasible) changed |= red.remove_conflicting();
+  }
+  return red.result();
+}
+TEST_CASE_FIXTURE(DLXPresolveFixture, "Function presolve") {
+  for (DLXMatrix &M : TestSample) {
+    CAPTURE(M);
+    count_t total = M.count_solutions();
+    Presolved P = presolve(M);
+    CHECK(P.matrix.nb_rows() <= M.nb_rows());
+    CHECK(P.matrix.nb_cols() <= M.nb_cols());
+    CHECK(P.count_solutions() == total);
+    for (const Vect1D &sol : P.matrix.search_rec())
+      CHECK(M.is_solution(P.original(sol)));
+    Presolved Q = presolve(M, {}, false);
+    CHECK((Q.count_solutions() > 0) == (total > 0));
+    for (const Vect1D &sol : Q.matrix.search_rec())
+      CHECK(M.is_solution(Q.original(sol)));
+  }
+}
+TEST_CASE("Function presolve : reductions") {
+  SUBCASE("Conflicting row") {
+    // The row {0, 3} meets both rows of column 1
+    DLXMatrix M(4, {{0, 1}, {0, 2}, {1, 3}, {2, 3}, {0, 3}});
+    Presolved P = presolve(M);
+    CHECK(P.matrix.nb_rows() == 4);
+    CHECK(P.row_map == Vect2D({{0}, {1}, {2}, {3}}));
+    CHECK(P.forced.empty());
+    CHECK(P.count_solutions() == 2);
+  }
+  SUBCASE("Duplicate rows") {
+    DLXMatrix M(3, {{0, 1}, {2}, {0, 1}});
+    Presolved P = presolve(M);
+    CHECK(P.matrix.nb_cols() == 0);
+    CHECK(P.forced == Vect2D({{0, 2}, {1}}));
+    CHECK(P.original({}) == Vect1D({0, 1}));
+    CHECK(P.nb_originals({}) == 2);
+    CHECK(P.count_solutions() == 2);
+  }
+  SUBCASE("Empty secondary column") {
+    DLXMatrix M(3, 2, {{0}, {1}, {0, 1}});
+    Presolved P = presolve(M);
+    CHECK(P.col_map == Vect1D({0, 1}));
+    CHECK(P.matrix.nb_primary() == 2);
+    CHECK(P.count_solutions() == 2);
+  }
+  SUBCASE("Dominated row") {
+    DLXMatrix M(3, 2, {{0}, {0, 2}, {1}});
+    CHECK(presolve(M).count_solutions() == 2);
+    Presolved P = presolve(M, {}, false);
+    CHECK(P.matrix.nb_cols() == 0);
+    CHECK(P.forced == Vect2D({{0}, {2}}));
+    CHECK(P.count_solutions() == 1);
+  }
+  SUBCASE("No solution") {
+    DLXMatrix M(3, {{0, 1}, {1, 2}});
+    Presolved P = presolve(M);
+    CHECK(!P.feasible);
+    CHECK(P.count_solutions() == 0);
+    CHECK(P.matrix.search_rec().empty());
+  }
+  SUBCASE("Errors") {
+    DLXMatrix M(3, {{0, 1}, {2}});
+    CHECK_THROWS_AS(presolve(M, {2}), std::runtime_error);
+    M.set_multiplicity(0, 1, 2);
+    CHECK_THROWS_AS(presolve(M), std::runtime_error);
+  }
+}
+TEST_CASE("Function presolve : chosen rows") {
+  DLXMatrix M = Langford_matrix(7);
+  for (ind_t r = 0; r < M.nb_rows(); r += 5) {
+    CAPTURE(r);
+    M.reset(0);
+    M.choose(r);
+    count_t total = M.count_solutions();
+    Presolved P = presolve(M, {r});
+    CHECK(P.count_solutions() == total);
+    CHECK(P.forced.front() == Vect1D({r}));
+  }
+  // Two chosen rows in conflict
+  M.reset(0);
+  CHECK(!presolve(M, {0, 0}).feasible);
+}
+
+Vect1D Presolved::original(const Vect1D &sol) const {
+  Vect1D res;
+  for (const Vect1D &alts : forced) res.push_back(alts.front());
+  for (ind_t r : sol) res.push_back(row_map.at(r).front());
+  return res;
+}
+
+count_t Presolved::nb_originals(const Vect1D &sol) const {
+  count_t res = 1;
+  for (const Vect1D &alts : forced) res *= alts.size();
+  for (ind_t r : sol) res *= row_map.at(r).size();
+  return res;
+}
+
+count_t Presolved::count_solutions() {
+  if (!feasible) return 0;
+  bool merged = false;
+  for (const Vect1D &alts : row_map) merged |= alts.size() > 1;
+  if (!merged) return nb_originals({}) * matrix.count_solutions();
+  count_t res = 0;
+  matrix.reset();
+  while (matrix.search_iter()) res += nb_originals(matrix.get_solution());
+  return res;
+}
+TEST_CASE("Method Presolved::count_solutions") {
+  // The rows {0, 1} and {2, 3} are doubled
+  DLXMatrix M(4, {{0, 1}, {2, 3}, {0, 1}, {2, 3}, {0, 2}, {1, 3}});
+  Presolved P = presolve(M);
+  CHECK(P.matrix.nb_rows() == 4);
+  CHECK(P.count_solutions() == M.count_solutions());
+  CHECK(P.count_solutions() == 5);
+}
+
+//////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_presolve]Presolve";
+//////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
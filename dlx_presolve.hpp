@@ -0,0 +1,70 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Shrinking an exact cover problem before the search
+//
+// The presolve repeats the following reductions until none applies:
+//  - a primary column with a single row forces this row;
+//  - a row which conflicts with every row of some primary column is removed;
+// after having merged the rows with the same columns, and, when only the
+// existence of a solution matters, removed the rows having the same primary
+// columns as another row and more secondary ones. The covered columns and the
+// empty secondary columns are dropped.
+//
+// The solutions of the original problem are the forced rows together with
+// the solutions of the reduced matrix, where each reduced row stands for any
+// of the original rows merged into it.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_PRESOLVE_HPP_
+#define DLX_PRESOLVE_HPP_
+
+#include <vector>  // vector
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+struct Presolved {
+  using ind_t = DLXMatrix::ind_t;
+  using Vect1D = DLXMatrix::Vect1D;
+  using Vect2D = DLXMatrix::Vect2D;
+  using count_t = DLXMatrix::count_t;
+
+  // The reduced problem. If there is no solution, this is a matrix with a
+  // single primary column and no row.
+  DLXMatrix matrix;
+  bool feasible = true;
+  // The original rows merged into each forced row, resp. each row of matrix
+  Vect2D forced, row_map;
+  // The original column of each column of matrix
+  Vect1D col_map;
+
+  // An original solution from a solution of matrix
+  Vect1D original(const Vect1D &sol) const;
+  // The number of original solutions from a solution of matrix
+  count_t nb_originals(const Vect1D &sol) const;
+  // The number of solutions of the original problem
+  count_t count_solutions();
+};
+
+// Presolve M at its root, with the rows of chosen in every solution.
+// If all_solutions is false, some solutions may be lost, keeping at least one
+// if any. Throws on colors or multiplicities.
+Presolved presolve(const DLXMatrix &M, const DLXMatrix::Vect1D &chosen = {},
+                   bool all_solutions = true);
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_PRESOLVE_HPP_
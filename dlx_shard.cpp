@@ -0,0 +1,239 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Splitting a search into independent work units
+//////////////////////////////////////////////////
+#include "dlx_shard.hpp"
+
+#include "dlx_test_fixtures.hpp"
+#include "doctest_ext.hpp"
+
+#include <sstream>    // stringstream
+#include <stdexcept>  // runtime_error
+#include <vector>     // vector
+
+namespace DLX_backtrack {
+
+//////////////////////////////////////////////////////
+TEST_SUITE_BEGIN("[dlx_shard]Work units");
+//////////////////////////////////////////////////////
+
+using Vect1D = DLXMatrix::Vect1D;
+using Vect2D = DLXMatrix::Vect2D;
+using ind_t = DLXMatrix::ind_t;
+
+std::vector<WorkUnit> make_units(DLXMatrix &M, size_t min_units,
+                                 size_t max_depth) {
+  Vect2D subs = M.subproblems(0);
+  for (size_t depth = 1; subs.size() < min_units && depth <= max_depth;
+       depth++) {
+    Vect2D deeper = M.subproblems(depth);
+    if (deeper == subs) break;  // all the branches end before depth
+    subs = std::move(deeper);
+  }
+  std::vector<WorkUnit> res;
+  for (size_t i = 0; i < subs.size(); i++) res.push_back({i, subs[i]});
+  return res;
+}
+TEST_CASE("Function make_units") {
+  DLXMatrix M = Langford_matrix(7);
+  std::vector<WorkUnit> units = make_units(M, 1);
+  REQUIRE(units.size() == 1);
+  CHECK(units[0].rows.empty());
+  units = make_units(M, 20);
+  CHECK(units.size() >= 20);
+  for (size_t i = 0; i < units.size(); i++) CHECK(units[i].index == i);
+  // Not enough nodes in the tree
+  M = DLXMatrix(3, {{0}, {1}, {2}, {0, 1}, {1, 2}});
+  units = make_units(M, 1000);
+  CHECK(units.size() == M.search_rec().size());
+  CHECK(make_units(M, 1000, 1).size() == 2);
+}
+
+UnitResult solve_unit(DLXMatrix &M, const WorkUnit &unit) {
+  const size_t base = M.depth();
+  M.reset(base);
+  for (ind_t r : unit.rows) M.choose(r);
+  M.reset(M.depth());
+  UnitResult res;
+  res.index = unit.index;
+  res.nb_solutions = M.count_solutions();
+  res.nb_choices = M.nb_choices;
+  res.nb_dances = M.nb_dances;
+  M.reset(base);
+  return res;
+}
+TEST_CASE_FIXTURE(DLXTestFixture, "Function solve_unit") {
+  std::vector<DLXMatrix> Sample = TestSample;
+  Sample.insert(Sample.end(), LangfordSample.begin(), LangfordSample.end());
+  for (DLXMatrix &M : Sample) {
+    CAPTURE(M);
+    DLXMatrix::count_t total = M.count_solutions();
+    for (size_t min_units : {1, 4, 50}) {
+      CAPTURE(min_units);
+      DLXMatrix::count_t sum = 0;
+      for (const WorkUnit &unit : make_units(M, min_units))
+        sum += solve_unit(M, unit).nb_solutions;
+      CHECK(sum == total);
+      CHECK(M.depth() == 0);
+    }
+  }
+}
+
+// Reads and checks the two lines of header of a unit or result file
+static void read_header(std::istream &in, const std::string &magic,
+                        std::string &matrix_id, size_t &nb_units) {
+  std::string word;
+  int version;
+  in >> word >> version >> matrix_id >> nb_units;
+  if (!in || word != magic || version != 1)
+    throw std::runtime_error("Shard : bad " + magic + " file");
+}
+
+void write_units(std::ostream &out, const std::string &matrix_id,
+                 size_t nb_units, const std::vector<WorkUnit> &units) {
+  out << "dlx-units 1\n" << matrix_id << ' ' << nb_units << '\n';
+  for (const WorkUnit &unit : units) {
+    out << unit.index << ' ' << unit.rows.size();
+    for (ind_t r : unit.rows) out << ' ' << r;
+    out << '\n';
+  }
+}
+std::vector<WorkUnit> read_units(std::istream &in, std::string &matrix_id,
+                                 size_t &nb_units) {
+  read_header(in, "dlx-units", matrix_id, nb_units);
+  std::vector<WorkUnit> res;
+  WorkUnit unit;
+  size_t len;
+  while (in >> unit.index >> len) {
+    unit.rows.resize(len);
+    for (ind_t &r : unit.rows) in >> r;
+    if (!in || unit.index >= nb_units)
+      throw std::runtime_error("Shard : bad unit");
+    res.push_back(unit);
+  }
+  if (!in.eof()) throw std::runtime_error("Shard : bad unit");
+  return res;
+}
+TEST_CASE("Functions write_units and read_units") {
+  DLXMatrix M = Langford_matrix(8);
+  std::vector<WorkUnit> units = make_units(M, 30);
+  std::stringstream file;
+  write_units(file, "langford:8", units.size(), units);
+  std::string id;
+  size_t nb;
+  std::vector<WorkUnit> back = read_units(file, id, nb);
+  CHECK(id == "langford:8");
+  CHECK(nb == units.size());
+  REQUIRE(back.size() == units.size());
+  for (size_t i = 0; i < units.size(); i++) {
+    CHECK(back[i].index == units[i].index);
+    CHECK(back[i].rows == units[i].rows);
+  }
+  std::stringstream bad1("dlx-results 1\nfoo 2\n");
+  CHECK_THROWS_AS(read_units(bad1, id, nb), std::runtime_error);
+  std::stringstream bad2("dlx-units 1\nfoo 2\n0 2 1\n");
+  CHECK_THROWS_AS(read_units(bad2, id, nb), std::runtime_error);
+  std::stringstream bad3("dlx-units 1\nfoo 2\n2 1 1\n");
+  CHECK_THROWS_AS(read_units(bad3, id, nb), std::runtime_error);
+}
+
+void write_results(std::ostream &out, const std::string &matrix_id,
+                   size_t nb_units, const std::vector<UnitResult> &results) {
+  out << "dlx-results 1\n" << matrix_id << ' ' << nb_units << '\n';
+  for (const UnitResult &r : results)
+    out << r.index << ' ' << count_to_string(r.nb_solutions) << ' '
+        << r.nb_choices << ' ' << r.nb_dances << '\n';
+}
+std::vector<UnitResult> read_results(std::istream &in,
+                                     std::string &matrix_id,
+                                     size_t &nb_units) {
+  read_header(in, "dlx-results", matrix_id, nb_units);
+  std::vector<UnitResult> res;
+  UnitResult r;
+  std::string count;
+  while (in >> r.index >> count >> r.nb_choices >> r.nb_dances) {
+    if (r.index >= nb_units) throw std::runtime_error("Shard : bad result");
+    r.nb_solutions = count_from_string(count);
+    res.push_back(r);
+  }
+  if (!in.eof()) throw std::runtime_error("Shard : bad result");
+  return res;
+}
+
+ShardSummary merge_results(std::vector<std::istream *> inputs,
+                           std::string &matrix_id) {
+  ShardSummary res;
+  std::vector<bool> seen;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    std::string id;
+    size_t nb_units;
+    std::vector<UnitResult> results = read_results(*inputs[i], id, nb_units);
+    if (i == 0) {
+      matrix_id = id;
+      res.nb_units = nb_units;
+      seen.resize(nb_units);
+    } else if (id != matrix_id || nb_units != res.nb_units) {
+      throw std::runtime_error("Shard : results of different jobs");
+    }
+    for (const UnitResult &r : results) {
+      if (seen[r.index]) throw std::runtime_error("Shard : unit solved twice");
+      seen[r.index] = true;
+      res.nb_solutions += r.nb_solutions;
+      res.nb_choices += r.nb_choices;
+      res.nb_dances += r.nb_dances;
+    }
+  }
+  for (bool b : seen)
+    if (!b) throw std::runtime_error("Shard : missing unit");
+  return res;
+}
+TEST_CASE("Function merge_results") {
+  DLXMatrix M = Langford_matrix(8);
+  DLXMatrix::count_t total = M.count_solutions();
+  unsigned long choices = M.nb_choices;
+  std::vector<WorkUnit> units = make_units(M, 10);
+  // Two shards, the units dealt in turn
+  std::vector<UnitResult> res0, res1;
+  for (const WorkUnit &unit : units)
+    (unit.index % 2 ? res1 : res0).push_back(solve_unit(M, unit));
+  std::stringstream file0, file1;
+  write_results(file0, "langford:8", units.size(), res0);
+  write_results(file1, "langford:8", units.size(), res1);
+  std::string id;
+  ShardSummary sum = merge_results({&file0, &file1}, id);
+  CHECK(id == "langford:8");
+  CHECK(sum.nb_units == units.size());
+  CHECK(sum.nb_solutions == total);
+  // The choices of the split are not counted
+  CHECK(sum.nb_choices < choices);
+
+  std::stringstream again0, again1, other;
+  write_results(again0, "langford:8", units.size(), res0);
+  CHECK_THROWS_AS(merge_results({&again0}, id), std::runtime_error);
+  write_results(again1, "langford:8", units.size(), res0);
+  write_results(other, "langford:9", units.size(), res1);
+  CHECK_THROWS_AS(merge_results({&again1, &other}, id), std::runtime_error);
+  std::stringstream twice0, twice1;
+  write_results(twice0, "langford:8", units.size(), res0);
+  write_results(twice1, "langford:8", units.size(), res0);
+  CHECK_THROWS_AS(merge_results({&twice0, &twice1}, id), std::runtime_error);
+}
+
+//////////////////////////////////////////////////////
+TEST_SUITE_END();  // "[dlx_shard]Work units";
+//////////////////////////////////////////////////////
+
+}  // namespace DLX_backtrack
@@ -0,0 +1,88 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Splitting a search into independent work units
+//
+// A work unit is a list of rows, chosen by the search from the root of the
+// problem (see DLXMatrix::subproblems). Any process which can rebuild the
+// matrix solves a unit by replaying its rows with DLXMatrix::choose, without
+// any shared memory. The units and the results are written in small text
+// files:
+//
+//   dlx-units 1                    dlx-results 1
+//   <matrix id> <nb units>         <matrix id> <nb units>
+//   <unit> <k> <row 1> ... <row k> <unit> <nb sols> <choices> <dances>
+//
+// where the matrix id is a free string without spaces naming the problem.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_SHARD_HPP_
+#define DLX_SHARD_HPP_
+
+#include <iostream>  // istream, ostream
+#include <string>    //
+#include <vector>    //
+
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+struct WorkUnit {
+  size_t index;
+  DLXMatrix::Vect1D rows;
+};
+
+struct UnitResult {
+  size_t index;
+  DLXMatrix::count_t nb_solutions = 0;
+  unsigned long int nb_choices = 0, nb_dances = 0;
+};
+
+struct ShardSummary {
+  DLXMatrix::count_t nb_solutions = 0;
+  size_t nb_units = 0;
+  unsigned long int nb_choices = 0, nb_dances = 0;
+};
+
+// Split the search of M below its current choices into at least min_units
+// units if the search tree is wide enough, going at most max_depth choices
+// deep. The units are numbered in search order.
+std::vector<WorkUnit> make_units(DLXMatrix &M, size_t min_units,
+                                 size_t max_depth = 64);
+
+// Count the solutions of a unit; M is left at its current choices.
+UnitResult solve_unit(DLXMatrix &M, const WorkUnit &unit);
+
+void write_units(std::ostream &out, const std::string &matrix_id,
+                 size_t nb_units, const std::vector<WorkUnit> &units);
+// Returns the units, and sets the matrix id and the total number of units.
+std::vector<WorkUnit> read_units(std::istream &in, std::string &matrix_id,
+                                 size_t &nb_units);
+
+void write_results(std::ostream &out, const std::string &matrix_id,
+                   size_t nb_units, const std::vector<UnitResult> &results);
+std::vector<UnitResult> read_results(std::istream &in,
+                                     std::string &matrix_id,
+                                     size_t &nb_units);
+
+// Sum up the results of all the units of a job. Throws if some unit is
+// missing or solved twice, or if the results come from different jobs. The
+// choices and the dances are the ones of the units: those made by
+// make_units to split the search are not counted.
+ShardSummary merge_results(std::vector<std::istream *> inputs,
+                           std::string &matrix_id);
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_SHARD_HPP_
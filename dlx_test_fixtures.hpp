@@ -0,0 +1,72 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Sample matrices shared by the tests
+//
+// The fixtures of the test files derive from DLXTestFixture and add their
+// own matrices to TestSample.
+//////////////////////////////////////////////////////////////////////////////
+#ifndef DLX_TEST_FIXTURES_HPP_
+#define DLX_TEST_FIXTURES_HPP_
+
+#include <vector>  // vector
+
+#include "dlx_examples.hpp"
+#include "dlx_matrix.hpp"
+
+namespace DLX_backtrack {
+
+// Small matrices for the corner cases: empty ones, without solution, with
+// secondary columns; and Langford matrices, which have many solutions.
+class DLXTestFixture {
+ public:
+  // clang-format off
+  DLXTestFixture() :
+// MA2AB
+//     0 1 2 3 4 5 6 7 8 9
+//  0 [1 0 0 0 1 0 0 0 0 0]
+//  1 [1 0 0 0 0 1 0 0 0 0]
+//  2 [1 0 0 0 0 0 1 0 0 0]
+//  3 [0 1 0 0 1 0 0 0 0 0]
+//  4 [0 1 0 0 0 1 0 0 0 0]
+//  5 [0 1 0 0 0 0 1 0 0 0]
+//  6 [0 0 1 0 1 0 0 0 0 1]
+//  7 [0 0 1 0 0 1 0 0 0 0]
+//  8 [0 0 1 0 0 0 1 0 0 0]
+//  9 [0 0 0 1 0 0 0 1 0 1]
+// 10 [0 1 0 0 0 1 0 0 1 0]
+      VA2AB{{0, 4}, {0, 5}, {0, 6}, {1, 4}, {1, 5}, {1, 6},
+            {2, 4, 9}, {2, 5}, {2, 6}, {3, 7, 9}, {1, 5, 8}},
+      V6_10{{0, 2}, {0, 1}, {1, 4}, {3}, {3, 4}, {5},
+            {1}, {0, 1, 2}, {2, 3, 4}, {1, 4, 5}},
+      TestSample({DLXMatrix(0), DLXMatrix(1), DLXMatrix(5),
+                  DLXMatrix(1, {{0}}),
+                  DLXMatrix(5, {{0, 1}, {2, 3, 4}}),
+                  DLXMatrix(5, {{0, 1}, {2, 3, 4}, {1, 2, 4}}),
+                  DLXMatrix(5, 3, {{0, 1}, {2}, {2, 3, 4}, {1, 2, 4}}),
+                  DLXMatrix(6, V6_10),
+                  DLXMatrix(10, 9, VA2AB), DLXMatrix(10, 8, VA2AB)}),
+      LangfordSample({Langford_matrix(4), Langford_matrix(7),
+                      Langford_matrix(8)}) {}
+  // clang-format on
+
+ protected:
+  DLXMatrix::Vect2D VA2AB, V6_10;
+  std::vector<DLXMatrix> TestSample, LangfordSample;
+};
+
+}  // namespace DLX_backtrack
+
+#endif  // DLX_TEST_FIXTURES_HPP_
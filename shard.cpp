@@ -0,0 +1,128 @@
+//****************************************************************************//
+//       Copyright (C) 2020 Florent Hivert <Florent.Hivert@lri.fr>,           //
+//                                                                            //
+//    Distributed under the terms of the GNU General Public License (GPL)     //
+//                                                                            //
+//    This code is distributed in the hope that it will be useful,            //
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of          //
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU       //
+//    General Public License for more details.                                //
+//                                                                            //
+//    The full text of the GPL is available at:                               //
+//                                                                            //
+//                  http://www.gnu.org/licenses/                              //
+//****************************************************************************//
+
+// Counting the solutions of a problem with independent processes
+//
+//   shard split <matrix id> <min units> <nb shards> <prefix>
+//       writes the units in the files <prefix>.0 ... <prefix>.<nb shards - 1>
+//   shard solve <units file>
+//       solves the units of the file and writes the results on stdout
+//   shard merge <results file>...
+//       sums up the results of all the units
+//
+// The matrix ids known are langford:<N>.
+//////////////////////////////////////////////////////////////////////////////
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dlx_examples.hpp"
+#include "dlx_matrix.hpp"
+#include "dlx_shard.hpp"
+
+using namespace DLX_backtrack;
+using ind_t = DLXMatrix::ind_t;
+
+DLXMatrix build_matrix(const std::string &id) {
+  if (id.compare(0, 9, "langford:") == 0) {
+    char *check;
+    ind_t N = strtoul(id.c_str() + 9, &check, 10);
+    if (*check == '\0' && N > 0) return Langford_matrix(N);
+  }
+  throw std::runtime_error("unknown matrix " + id);
+}
+
+size_t parse_size(const char *str) {
+  char *check;
+  size_t res = strtoul(str, &check, 10);
+  if (*check != '\0' || res == 0)
+    throw std::runtime_error(std::string("bad number: ") + str);
+  return res;
+}
+
+void split(const std::string &id, size_t min_units, size_t nb_shards,
+           const std::string &prefix) {
+  DLXMatrix M = build_matrix(id);
+  std::vector<WorkUnit> units = make_units(M, min_units);
+  // Neighbor units share their first choices, they are dealt in turn so that
+  // the shards get about the same amount of work.
+  std::vector<std::vector<WorkUnit>> shards(nb_shards);
+  for (const WorkUnit &unit : units)
+    shards[unit.index % nb_shards].push_back(unit);
+  for (size_t i = 0; i < nb_shards; i++) {
+    std::ofstream out(prefix + "." + std::to_string(i));
+    write_units(out, id, units.size(), shards[i]);
+    if (!out) throw std::runtime_error("cannot write " + prefix);
+  }
+  std::cout << units.size() << " units in " << nb_shards << " shards"
+            << std::endl;
+}
+
+void solve(const std::string &file) {
+  std::ifstream in(file);
+  if (!in) throw std::runtime_error("cannot read " + file);
+  std::string id;
+  size_t nb_units;
+  std::vector<WorkUnit> units = read_units(in, id, nb_units);
+  DLXMatrix M = build_matrix(id);
+  std::vector<UnitResult> results;
+  for (const WorkUnit &unit : units) results.push_back(solve_unit(M, unit));
+  write_results(std::cout, id, nb_units, results);
+}
+
+void merge(const std::vector<std::string> &files) {
+  std::vector<std::ifstream> ins;
+  for (const std::string &file : files) {
+    ins.emplace_back(file);
+    if (!ins.back()) throw std::runtime_error("cannot read " + file);
+  }
+  std::vector<std::istream *> inputs;
+  for (auto &in : ins) inputs.push_back(&in);
+  std::string id;
+  ShardSummary sum = merge_results(inputs, id);
+  std::cout << "Matrix: " << id << ", units: " << sum.nb_units << std::endl;
+  std::cout << "Number of solutions: " << count_to_string(sum.nb_solutions)
+            << std::endl;
+  // Without the split, see merge_results
+  std::cout << "# Number of choices: " << sum.nb_choices
+            << ", Number of dances: " << sum.nb_dances << " (in the units)"
+            << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    if (argc == 6 && std::strcmp(argv[1], "split") == 0) {
+      split(argv[2], parse_size(argv[3]), parse_size(argv[4]), argv[5]);
+    } else if (argc == 3 && std::strcmp(argv[1], "solve") == 0) {
+      solve(argv[2]);
+    } else if (argc >= 3 && std::strcmp(argv[1], "merge") == 0) {
+      merge(std::vector<std::string>(argv + 2, argv + argc));
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " split <matrix id> <min units> <nb shards> <prefix>\n"
+                << "       " << argv[0] << " solve <units file>\n"
+                << "       " << argv[0] << " merge <results file>..."
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+}
@@ -14,19 +14,39 @@
 //****************************************************************************//
 
 // Implementation of Knuth dancing links backtrack algorithm
-//////////////////////////////////////////////////////////////
-#include <cassert>
+//
+//   sudsol [file]
+//       solves a single sudoku and prints its grid
+//   sudsol -b [-j threads] [file]
+//       batch mode: solves a stream of sudokus and prints one line for each,
+//       either the solution, "none", "several" or "error"
+//
+// In batch mode, a sudoku is either a line of 81 characters, the hints of a
+// standard 9x9 sudoku with '.' or '0' for the empty cells, or a sudoku in the
+// 's' or 'g' format of the single mode. Lines starting with '#' are ignored.
+// A sudoku which can't be read or solved gets the line "error", the reason
+// goes to stderr and the batch goes on. After a character which isn't a
+// number in the 's' or 'g' format, the reading resumes at the next line.
+//////////////////////////////////////////////////////////////////////////////
+#include <atomic>
+#include <cctype>  // isspace
 #include <chrono>
 #include <cstring>
 #include <ctime>  // time
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
 
 #include "dlx_matrix.hpp"
+#include "dlx_presolve.hpp"
 #include "hash_tuple.hpp"
 
 namespace cron = std::chrono;
@@ -35,25 +55,32 @@ using item_t = std::tuple<char, int, int>;
 using opt_t = std::tuple<int, int, int>;
 using SQMatrix = std::vector<std::vector<int>>;
 using ind_t = DLX_backtrack::DLXMatrix::ind_t;
+// The items are indexed arithmetically from their ranges
+using Matrix = DLX_backtrack::DLXMatrixIdent<
+    item_t, opt_t, DLX_backtrack::RangeIndexer<item_t>,
+    hash_tuple::hash<opt_t>>;
 
-int row_size, col_size, sq_size, nb_hint;
-SQMatrix blocks, matrix;
+struct Sudoku {
+  int row_size = 0, col_size = 0, sq_size = 0, nb_hint = 0;
+  SQMatrix blocks, hints;
+  std::string error;  // in batch mode, why the sudoku can't be solved
+};
 
-std::vector<item_t> set_box_option(int row, int col, int nb) {
-  std::vector<item_t> res;
+void set_box_option(const Sudoku &sud, int row, int col, int nb,
+                    std::vector<item_t> &res) {
+  res.clear();
   res.emplace_back('r', row, nb);
   res.emplace_back('c', col, nb);
   res.emplace_back('s', row, col);
-  res.emplace_back('b', blocks[row - 1][col - 1], nb);
-  return res;
+  res.emplace_back('b', sud.blocks[row - 1][col - 1], nb);
 }
 
-void cout_mat(const SQMatrix &m) {
-  for (int r = 0; r < sq_size; r++) {
-    if ((row_size != 0) && (r % row_size == 0)) std::cout << "\n";
+void cout_mat(const Sudoku &sud, const SQMatrix &m) {
+  for (int r = 0; r < sud.sq_size; r++) {
+    if ((sud.row_size != 0) && (r % sud.row_size == 0)) std::cout << "\n";
     std::cout << "  ";
-    for (int c = 0; c < sq_size; c++) {
-      if ((col_size != 0) && (c % col_size == 0)) std::cout << " ";
+    for (int c = 0; c < sud.sq_size; c++) {
+      if ((sud.col_size != 0) && (c % sud.col_size == 0)) std::cout << " ";
       if (m[r][c] != 0) {
         std::cout << m[r][c] << " ";
       } else {
@@ -64,45 +91,68 @@ void cout_mat(const SQMatrix &m) {
   }
 }
 
-void read_sudoku(std::istream &in) {
+// Standard block structure, hints cleared
+void standard_blocks(Sudoku &sud, int col_size, int row_size) {
+  sud.col_size = col_size;
+  sud.row_size = row_size;
+  sud.sq_size = col_size * row_size;
+  const std::vector<int> empty_row(sud.sq_size);
+  sud.blocks.assign(sud.sq_size, empty_row);
+  sud.hints.assign(sud.sq_size, empty_row);
+  for (int r = 0; r < sud.sq_size; r++) {
+    for (int c = 0; c < sud.sq_size; c++)
+      sud.blocks[r][c] = c / col_size + row_size * (r / row_size) + 1;
+  }
+}
+
+// Throws a runtime_error on a wrong sudoku. The hints out of range and the
+// wrong blocks are only reported once the whole sudoku is read.
+void read_sudoku(std::istream &in, Sudoku &sud, bool verbose) {
   char type, unused;
+  int col_size, row_size;
+  std::string error;
   in >> type;
   switch (type) {
     case 's':
       in >> col_size >> unused >> row_size;
-      assert(unused == 'x');
-      sq_size = col_size * row_size;
-      std::cout << "# Standard sudoku (block size = " << col_size << "x"
-                << row_size << ", square size = " << sq_size << ")\n";
+      if (!in || unused != 'x' || col_size <= 0 || row_size <= 0)
+        throw std::runtime_error("Bad block size");
+      standard_blocks(sud, col_size, row_size);
+      if (verbose)
+        std::cout << "# Standard sudoku (block size = " << sud.col_size << "x"
+                  << sud.row_size << ", square size = " << sud.sq_size
+                  << ")\n";
       break;
 
     case 'g':
-      in >> sq_size;
-      std::cout << "# Generalized sudoku " << sq_size << "x" << sq_size << "\n";
+      in >> sud.sq_size;
+      if (!in || sud.sq_size <= 0)
+        throw std::runtime_error("Bad square size");
+      sud.row_size = sud.col_size = 0;
+      if (verbose)
+        std::cout << "# Generalized sudoku " << sud.sq_size << "x"
+                  << sud.sq_size << "\n";
+      // Dynamic allocation of the matrices.
+      sud.blocks.assign(sud.sq_size, std::vector<int>(sud.sq_size));
+      sud.hints.assign(sud.sq_size, std::vector<int>(sud.sq_size));
+      for (int r = 0; r < sud.sq_size; r++) {
+        for (int c = 0; c < sud.sq_size; c++) {
+          int &block = sud.blocks[r][c];
+          if (!(in >> block)) throw std::runtime_error("Bad block");
+          if ((block <= 0 || block > sud.sq_size) && error.empty())
+            error = "Bad block <" + std::to_string(block) + ">";
+        }
+      }
       break;
 
     default:
-      std::cerr << "Unknown block type <" << type << std::endl;
-      exit(EXIT_FAILURE);
-  }
-
-  // Dynamic allocation of the matrices.
-  const std::vector<int> empty_row(sq_size);
-  blocks.resize(sq_size, empty_row);
-  matrix.resize(sq_size, empty_row);
-
-  if (type == 's') {  // Standard block structure
-    for (int r = 0; r < sq_size; r++) {
-      for (int c = 0; c < sq_size; c++)
-        blocks[r][c] = c / col_size + row_size * (r / row_size) + 1;
-    }
-  } else {  // Generalized block structure
-    for (int r = 0; r < sq_size; r++)
-      for (int c = 0; c < sq_size; c++) in >> blocks[r][c];
+      throw std::runtime_error(std::string("Unknown block type <") + type +
+                               ">");
   }
 
   // Hint of the problem statement
-  nb_hint = 0;
+  const int sq_size = sud.sq_size;
+  sud.nb_hint = 0;
   for (int r = 0; r < sq_size; r++) {
     for (int c = 0; c < sq_size; c++) {
       char ch = in.peek();
@@ -110,38 +160,70 @@ void read_sudoku(std::istream &in) {
         in.ignore();
         ch = in.peek();
       }
-      matrix[r][c] = 0;
+      sud.hints[r][c] = 0;
       if (ch == '.') {
         in.ignore();
+      } else if (!(in >> sud.hints[r][c])) {
+        throw std::runtime_error(std::string("Bad character <") + ch + ">");
+      } else if (sud.hints[r][c] <= 0 || sud.hints[r][c] > sq_size) {
+        if (error.empty())
+          error = "Bad hint <" + std::to_string(sud.hints[r][c]) + ">";
       } else {
-        matrix[r][c] = 0;
-        in >> matrix[r][c];
-        if (matrix[r][c] == 0) {
-          std::cerr << "Bad character <" << in.peek() << ">" << std::endl;
-          exit(EXIT_FAILURE);
-        } else {
-          nb_hint++;
-        }
+        sud.nb_hint++;
       }
     }
   }
+  if (!error.empty()) throw std::runtime_error(error);
 }
 
-int main(int argc, char *argv[]) {
-  auto tstart = cron::high_resolution_clock::now();
-  if (argc > 1) {
-    std::ifstream ifile(argv[1]);
-    if (ifile) {
-      read_sudoku(ifile);
+// Reads the next sudoku of a batch, returns false at the end of the input.
+// A wrong sudoku is returned with its error set.
+bool read_batch_sudoku(std::istream &in, Sudoku &sud) {
+  std::string line;
+  sud.error.clear();
+  while (true) {
+    in >> std::ws;
+    int ch = in.peek();
+    if (ch == EOF) return false;
+    if (ch == 's' || ch == 'g') {
+      try {
+        read_sudoku(in, sud, false);
+      } catch (const std::runtime_error &e) {
+        sud.error = e.what();
+        if (!in) {
+          in.clear();
+          in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+      }
+      return true;
+    }
+    std::getline(in, line);
+    if (line[0] != '#') break;
+  }
+  while (!line.empty() && isspace(line.back())) line.pop_back();
+  if (line.size() != 81) {
+    sud.error = "Bad sudoku line <" + line + ">";
+    return true;
+  }
+  if (sud.col_size != 3 || sud.row_size != 3) standard_blocks(sud, 3, 3);
+  sud.nb_hint = 0;
+  for (int i = 0; i < 81; i++) {
+    char ch = line[i];
+    if (ch == '.' || ch == '0') {
+      sud.hints[i / 9][i % 9] = 0;
+    } else if ('1' <= ch && ch <= '9') {
+      sud.hints[i / 9][i % 9] = ch - '0';
+      sud.nb_hint++;
     } else {
-      std::cerr << "File not found : " << argv[1] << std::endl;
-      exit(EXIT_FAILURE);
+      sud.error = std::string("Bad character <") + ch + ">";
+      return true;
     }
-  } else {
-    read_sudoku(std::cin);
   }
+  return true;
+}
 
-  auto tencode = std::chrono::high_resolution_clock::now();
+Matrix make_matrix(const Sudoku &sud) {
+  const int sq_size = sud.sq_size;
   std::vector<item_t> items;
   for (int i = 1; i <= sq_size; i++)  // Square i,j occupied
     for (int j = 1; j <= sq_size; j++) items.emplace_back('s', i, j);
@@ -152,46 +234,194 @@ int main(int argc, char *argv[]) {
   for (int i = 1; i <= sq_size; i++)  // Col i occupied by j
     for (int j = 1; j <= sq_size; j++) items.emplace_back('c', i, j);
 
-  DLX_backtrack::DLXMatrixIdent<item_t, opt_t, hash_tuple::hash<item_t>> M(
-      std::move(items));  // items is no more needed
+  Matrix M(std::move(items));  // items is no more needed
 
   // Rules of the Sudoku game
+  std::vector<item_t> opt;
   for (int r = 1; r <= sq_size; r++) {
     for (int c = 1; c <= sq_size; c++) {
       for (int n = 1; n <= sq_size; n++) {
-        M.add_opt({r, c, n}, set_box_option(r, c, n));
+        set_box_option(sud, r, c, n, opt);
+        M.add_opt({r, c, n}, opt);
       }
     }
   }
-  for (int r = 1; r <= sq_size; r++) {
-    for (int c = 1; c <= sq_size; c++) {
-      if (matrix[r - 1][c - 1] != 0) {
-        M.choose({r, c, matrix[r - 1][c - 1]});
+  return M;
+}
+
+// One line of the batch output. M is reset and reused from sudoku to sudoku
+// of the same blocks.
+std::string solve_batch_sudoku(Matrix &M, const Sudoku &sud) {
+  const int sq_size = sud.sq_size;
+  std::vector<opt_t> hints;
+  for (int r = 1; r <= sq_size; r++)
+    for (int c = 1; c <= sq_size; c++)
+      if (sud.hints[r - 1][c - 1] != 0)
+        hints.emplace_back(r, c, sud.hints[r - 1][c - 1]);
+  M.reset();
+  if (!M.choose_all(hints)) return "none";  // Two hints in conflict
+  if (!M.search_iter()) return "none";
+  std::vector<opt_t> sol = M.get_solution();
+  if (M.search_iter()) return "several";
+  SQMatrix solution(sq_size, std::vector<int>(sq_size));
+  for (auto [r, c, n] : sol) solution[r - 1][c - 1] = n;
+  std::string res;
+  for (int r = 0; r < sq_size; r++) {
+    for (int c = 0; c < sq_size; c++) {
+      if (sq_size <= 9) {
+        res += static_cast<char>('0' + solution[r][c]);
+      } else {
+        if (!res.empty()) res += ' ';
+        res += std::to_string(solution[r][c]);
+      }
+    }
+  }
+  return res;
+}
+
+// The sudokus are read and solved by chunks, so that the output comes in
+// the order of the input. Each thread keeps one matrix for each blocks it
+// has met, across the chunks.
+void solve_batch(std::istream &in, size_t nb_threads) {
+  auto tstart = cron::high_resolution_clock::now();
+  const size_t chunk_size = 1024 * nb_threads;
+  std::vector<std::map<SQMatrix, Matrix>> matrices(nb_threads);
+  std::vector<Sudoku> chunk;
+  std::vector<std::string> results;
+  size_t nb_sudokus = 0, nb_none = 0, nb_several = 0, nb_error = 0;
+  bool more = true;
+  while (more) {
+    chunk.resize(chunk_size);
+    size_t nb = 0;
+    while (nb < chunk_size && (more = read_batch_sudoku(in, chunk[nb]))) nb++;
+    results.assign(nb, std::string());
+    std::atomic<size_t> next(0);
+    auto work = [&](size_t thread) {
+      for (size_t i = next++; i < nb; i = next++) {
+        if (!chunk[i].error.empty()) {
+          results[i] = "error";
+          continue;
+        }
+        try {
+          auto it = matrices[thread].find(chunk[i].blocks);
+          if (it == matrices[thread].end())
+            it = matrices[thread]
+                     .emplace(chunk[i].blocks, make_matrix(chunk[i]))
+                     .first;
+          results[i] = solve_batch_sudoku(it->second, chunk[i]);
+        } catch (const std::exception &e) {
+          chunk[i].error = e.what();
+          results[i] = "error";
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < nb_threads && t < nb; t++)
+      threads.emplace_back(work, t);
+    work(0);
+    for (std::thread &th : threads) th.join();
+    for (size_t i = 0; i < nb; i++) {
+      std::cout << results[i] << "\n";
+      if (results[i] == "none") nb_none++;
+      if (results[i] == "several") nb_several++;
+      if (results[i] == "error") {
+        nb_error++;
+        std::cerr << "Sudoku " << nb_sudokus + i + 1 << ": " << chunk[i].error
+                  << std::endl;
+      }
+    }
+    nb_sudokus += nb;
+  }
+  auto tend = cron::high_resolution_clock::now();
+  double secs = cron::duration<double>(tend - tstart).count();
+  std::cout << "# Sudokus: " << nb_sudokus << ", no solution: " << nb_none
+            << ", several solutions: " << nb_several
+            << ", errors: " << nb_error << "\n";
+  std::cout << std::fixed << std::setprecision(3) << "# Time = " << secs
+            << "s, threads = " << nb_threads << ", " << std::setprecision(0)
+            << nb_sudokus / secs << " sudokus/s\n";
+}
+
+int main(int argc, char *argv[]) {
+  auto tstart = cron::high_resolution_clock::now();
+  bool batch = false;
+  size_t nb_threads = std::thread::hardware_concurrency();
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; arg++) {
+    if (std::strcmp(argv[arg], "-b") == 0) {
+      batch = true;
+    } else if (std::strcmp(argv[arg], "-j") == 0 && arg + 1 < argc) {
+      nb_threads = atoi(argv[++arg]);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [file]\n"
+                << "       " << argv[0] << " -b [-j threads] [file]"
+                << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (nb_threads == 0) nb_threads = 1;
+
+  std::ifstream ifile;
+  if (arg < argc) {
+    ifile.open(argv[arg]);
+    if (!ifile) {
+      std::cerr << "File not found : " << argv[arg] << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+  std::istream &input = arg < argc ? ifile : std::cin;
+  if (batch) {
+    solve_batch(input, nb_threads);
+    return EXIT_SUCCESS;
+  }
+  Sudoku sud;
+  try {
+    read_sudoku(input, sud, true);
+  } catch (const std::runtime_error &e) {
+    std::cerr << e.what() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto tencode = std::chrono::high_resolution_clock::now();
+  Matrix M = make_matrix(sud);
+  std::vector<ind_t> hints;
+  for (int r = 1; r <= sud.sq_size; r++) {
+    for (int c = 1; c <= sud.sq_size; c++) {
+      if (sud.hints[r - 1][c - 1] != 0) {
+        hints.push_back(M.get_opt_ind({r, c, sud.hints[r - 1][c - 1]}));
       }
     }
   }
 
   auto tcompute = std::chrono::high_resolution_clock::now();
 
-  if (!M.search_iter()) {
+  // Most of the cells are usually filled by the presolve
+  DLX_backtrack::Presolved P = DLX_backtrack::presolve(M.matrix(), hints);
+  if (!P.matrix.search_iter()) {
     std::cout << "No solution found !" << std::endl;
     exit(EXIT_FAILURE);
   }
-  auto soldance = M.get_solution();
-  if (M.search_iter()) {
+  auto soldance = P.original(P.matrix.get_solution());
+  if (P.matrix.search_iter()) {
     std::cout << "More than one solution found !" << std::endl;
     exit(EXIT_FAILURE);
   }
-  SQMatrix solution(sq_size, std::vector<int>(sq_size));
-  for (auto [r, c, n] : soldance) solution[r - 1][c - 1] = n;
+  SQMatrix solution(sud.sq_size, std::vector<int>(sud.sq_size));
+  for (ind_t i : soldance) {
+    auto [r, c, n] = M.get_opt_id(i);
+    solution[r - 1][c - 1] = n;
+  }
 
   auto endcompute = cron::high_resolution_clock::now();
   std::cout << std::endl;
-  cout_mat(solution);
+  cout_mat(sud, solution);
   std::cout << std::endl;
   auto endprint = cron::high_resolution_clock::now();
-  std::cout << "# Number of choices: " << M.nb_choices
-            << ", Number of dances: " << M.nb_dances << "\n";
+  std::cout << "# Presolve: " << P.forced.size() - hints.size()
+            << " forced rows, " << P.matrix.nb_rows() << " rows and "
+            << P.matrix.nb_cols() << " columns left\n";
+  std::cout << "# Number of choices: " << P.matrix.nb_choices
+            << ", Number of dances: " << P.matrix.nb_dances << "\n";
   std::cout << std::fixed << std::setprecision(0) << "# Timings: parse = "
             << cron::duration<float, std::micro>(tencode - tstart).count()
             << "μs, encode = "